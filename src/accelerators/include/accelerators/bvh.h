@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/primitive.h>
+#include <atomic>
 
 RIGA_NAMESPACE_BEGIN
 
@@ -41,6 +42,28 @@ struct BucketInfo{
 	Bounds3f bucketBounds;
 };
 
+struct MortonPrimitive{
+	int primIndex;
+	uint32_t mortonCode;
+};
+
+struct LBVHTreelet{
+	int startIndex, nPrimitives;
+	BVHNode* buildNodes;
+};
+
+// preallocated storage for the build nodes, shared by all build tasks
+struct BVHBuildArena{
+	explicit BVHBuildArena(size_t nPrims) 
+		: nodes(2 * nPrims - 1), totalNodes(0){}
+	BVHNode* alloc(){
+		return &nodes[totalNodes++];
+	}
+
+	std::vector<BVHNode> nodes;
+	std::atomic<int> totalNodes;
+};
+
 struct LinearBVHNode{
 	Bounds3f bounds;
 	union {
@@ -55,23 +78,35 @@ struct LinearBVHNode{
 
 class BVH : public Aggregate{
 public:
-	enum class SplitMethod {SAH, Middle, EqualCounts};
+	enum class SplitMethod {SAH, HLBVH, Middle, EqualCounts};
 	BVH(std::vector<std::shared_ptr<Primitive>> prims, 
 		int maxPrimsInNode = 1, SplitMethod method = SplitMethod::SAH);
 	~BVH();
 	Bounds3f worldBound() const;
 	bool intersect(const Ray& ray, SurfaceInteraction* isect) const;
 	bool intersectP(const Ray& ray) const;
+	bool intersectP(const Ray& ray, const Primitive** occluder) const;
+
+	// the builders never go deeper than this, traversal uses a fixed size stack
+	static constexpr int MaxDepth = 64;
 
-private:
-	BVHNode* recursiveBuild(std::vector<BVHPrimInfo>& primInfo, int* total_nodes,
-		int start, int end, std::vector<std::shared_ptr<Primitive>>& orderedPrims);
+protected:
+	BVHNode* recursiveBuild(BVHBuildArena& arena, std::vector<BVHPrimInfo>& primInfo,
+		int start, int end, std::vector<std::shared_ptr<Primitive>>& orderedPrims, int depth);
+	BVHNode* HLBVHBuild(BVHBuildArena& arena, const std::vector<BVHPrimInfo>& primInfo,
+		std::vector<std::shared_ptr<Primitive>>& orderedPrims) const;
+	BVHNode* emitLBVH(BVHBuildArena& arena, const std::vector<BVHPrimInfo>& primInfo,
+		const MortonPrimitive* mortonPrims, int firstPrimIndex, int nPrims,
+		std::vector<std::shared_ptr<Primitive>>& orderedPrims, int bitIndex) const;
+	BVHNode* buildUpperSAH(BVHBuildArena& arena, std::vector<BVHNode*>& treeletRoots,
+		int start, int end, int depth) const;
 	
-	int flattenBVHTree(BVHNode* node, int* offset);
+	int flattenBVHTree(BVHNode* node, int* offset, int depth);
 
 	const int maxPrimsInNode;
 	const SplitMethod splitMethod;
 	LinearBVHNode* root = nullptr;
+	int maxDepth = 0;
 };
 
 
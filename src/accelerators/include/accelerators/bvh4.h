@@ -0,0 +1,130 @@
+#pragma once
+
+#include <accelerators/bvh.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RIGA_BVH4_SSE
+#endif
+
+RIGA_NAMESPACE_BEGIN
+
+// four children per node, bounds stored as SoA so that one SIMD slab test
+// checks all of them at once
+struct alignas(16) BVH4Node{
+	// bounds[0 : min, 1 : max][axis][child]
+	float bounds[2][3][4];
+	// interior : offset of the child node, leaf : first primitive index, empty : -1
+	int children[4];
+	uint16_t nPrimitives[4];
+};
+
+struct BVH4StackEntry{
+	int offset;
+	int nPrimitives;
+	float tNear;
+};
+
+// slab test of a ray against the four child boxes of node, returns a bit mask of hit children
+inline int intersectChildren(const BVH4Node& node, const float org[3], const float invDir[3],
+	const int isDirNeg[3], float tMin, float tMax, float tNear[4]){
+#ifdef RIGA_BVH4_SSE
+	__m128 t0 = _mm_set1_ps(tMin), t1 = _mm_set1_ps(tMax);
+	for(int a=0; a<3; ++a){
+		const __m128 o = _mm_set1_ps(org[a]), inv = _mm_set1_ps(invDir[a]);
+		const __m128 tn = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[isDirNeg[a]][a]), o), inv);
+		const __m128 tf = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[1 - isDirNeg[a]][a]), o), inv);
+		t0 = _mm_max_ps(tn, t0);
+		t1 = _mm_min_ps(tf, t1);
+	}
+	_mm_storeu_ps(tNear, t0);
+	return _mm_movemask_ps(_mm_cmple_ps(t0, t1));
+#else
+	int mask = 0;
+	for(int i=0; i<4; ++i){
+		float t0 = tMin, t1 = tMax;
+		for(int a=0; a<3; ++a){
+			float tn = (node.bounds[isDirNeg[a]][a][i] - org[a]) * invDir[a];
+			float tf = (node.bounds[1 - isDirNeg[a]][a][i] - org[a]) * invDir[a];
+			t0 = tn > t0 ? tn : t0;
+			t1 = tf < t1 ? tf : t1;
+		}
+		tNear[i] = t0;
+		if(t0 <= t1)
+			mask |= (1 << i);
+	}
+	return mask;
+#endif
+}
+
+class BVH4 : public BVH{
+public:
+	BVH4(std::vector<std::shared_ptr<Primitive>> prims,
+		int maxPrimsInNode = 4, SplitMethod method = SplitMethod::SAH);
+	Bounds3f worldBound() const;
+	bool intersect(const Ray& ray, SurfaceInteraction* isect) const;
+	bool intersectP(const Ray& ray) const;
+	bool intersectP(const Ray& ray, const Primitive** occluder) const;
+
+protected:
+	// calls leafTest(offset, nPrimitives) for every leaf hit by ray, leafTest returns true 
+	// to stop the traversal. children are visited near to far, closest hit traversal also
+	// skips the ones that start behind ray.tMax
+	template <bool closestHit, typename LeafTest>
+	void traverse(const Ray& ray, LeafTest leafTest) const;
+
+	std::vector<BVH4Node> nodes;
+
+private:
+	int collapse(const int* binaryChildren, int nChildren);
+
+	Bounds3f bounds;
+};
+
+template <bool closestHit, typename LeafTest>
+void BVH4::traverse(const Ray& ray, LeafTest leafTest) const{
+	if(nodes.empty())
+		return;
+
+	const float org[3] = {ray.o.x, ray.o.y, ray.o.z};
+	const float invDir[3] = {1.f / ray.dir.x, 1.f / ray.dir.y, 1.f / ray.dir.z};
+	const int isDirNeg[3] = {ray.dir.x < 0.f, ray.dir.y < 0.f, ray.dir.z < 0.f};
+
+	// collapsing never makes the tree deeper, so BVH::MaxDepth bounds the stack too
+	BVH4StackEntry need2Test[3 * MaxDepth + 1];
+	int top = 0;
+	need2Test[top++] = {0, 0, ray.tMin};
+	while(top > 0){
+		const BVH4StackEntry entry = need2Test[--top];
+		if(closestHit && entry.tNear > ray.tMax)
+			continue;
+
+		if(entry.nPrimitives > 0){
+			if(leafTest(entry.offset, entry.nPrimitives))
+				return;
+			continue;
+		}
+
+		const BVH4Node& node = nodes[entry.offset];
+		float tNear[4];
+		int mask = intersectChildren(node, org, invDir, isDirNeg, ray.tMin, ray.tMax, tNear);
+
+		// sort hit children far to near, so the nearest one is popped first. shadow rays
+		// profit too, blockers tend to sit close to the shading point
+		int order[4], nHit = 0;
+		for(int i=0; i<4; ++i){
+			if(!(mask & (1 << i)))
+				continue;
+			int j = nHit++;
+			for(; j > 0 && tNear[order[j - 1]] < tNear[i]; --j)
+				order[j] = order[j - 1];
+			order[j] = i;
+		}
+		for(int i=0; i<nHit; ++i){
+			const int c = order[i];
+			need2Test[top++] = {node.children[c], node.nPrimitives[c], tNear[c]};
+		}
+	}
+}
+
+RIGA_NAMESPACE_END
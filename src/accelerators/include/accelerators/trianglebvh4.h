@@ -0,0 +1,32 @@
+#pragma once
+
+#include <accelerators/bvh4.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// four triangles in SoA layout with the edges precomputed for Moller Trumbore
+struct alignas(16) TriangleBlock4{
+	float v0[3][4];
+	float e1[3][4];
+	float e2[3][4];
+	// index into primitives, -1 for empty lanes
+	int primIndex[4];
+	// lanes holding other shapes, those are tested through Primitive::intersect
+	int genericMask;
+};
+
+// BVH4 whose leaves store triangle blocks in leaf order, so intersection runs on
+// contiguous vertex data and the shading data is only fetched for the closest hit
+class TriangleBVH4 : public BVH4{
+public:
+	TriangleBVH4(std::vector<std::shared_ptr<Primitive>> prims,
+		int maxPrimsInNode = 4, SplitMethod method = SplitMethod::SAH);
+	bool intersect(const Ray& ray, SurfaceInteraction* isect) const;
+	bool intersectP(const Ray& ray) const;
+	bool intersectP(const Ray& ray, const Primitive** occluder) const;
+
+private:
+	std::vector<TriangleBlock4> blocks;
+};
+
+RIGA_NAMESPACE_END
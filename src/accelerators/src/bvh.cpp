@@ -1,10 +1,165 @@
 #include <accelerators/bvh.h>
 #include <vector>
 #include <algorithm>
-#include <stack>
+#include <array>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/parallel_invoke.h>
 
 RIGA_NAMESPACE_BEGIN
 
+// BVH Local Constants
+static constexpr int nBuckets = 12;
+// nodes with more primitives than this build their children as parallel tasks
+static constexpr int ParallelBuildThreshold = 4096;
+// nodes with more primitives than this reduce bounds and buckets in parallel
+static constexpr int ParallelReduceThreshold = 65536;
+// below this depth only equal count splits are made, which needs at most 32 more levels
+static constexpr int EqualCountsDepth = BVH::MaxDepth - 32;
+// the upper tree of HLBVH switches to equal count splits here, the 4096 treelets
+// need 12 more levels and the treelets themselves 19 at most
+static constexpr int UpperSAHEqualCountsDepth = 16;
+
+// BVH Utility Functions
+static inline int bucketIndex(const Bounds3f& centroidBounds, const Point3f& centroid, int splitDim){
+	int b = static_cast<int>(nBuckets * centroidBounds.offset(centroid)[splitDim]);
+	return b == nBuckets ? nBuckets - 1 : b;
+}
+
+static void computeBounds(const std::vector<BVHPrimInfo>& primInfo, int start, int end,
+	Bounds3f* bounds, Bounds3f* centroidBounds){
+	typedef std::pair<Bounds3f, Bounds3f> BoundsPair;
+	auto accumulate = [&](const tbb::blocked_range<int>& r, BoundsPair b){
+		for(int i=r.begin(); i<r.end(); ++i){
+			b.first = Union(b.first, primInfo[i].bounds);
+			b.second = Union(b.second, primInfo[i].centroid);
+		}
+		return b;
+	};
+	BoundsPair result;
+	if(end - start > ParallelReduceThreshold)
+		result = tbb::parallel_reduce(tbb::blocked_range<int>(start, end), BoundsPair(), accumulate,
+			[](const BoundsPair& b1, const BoundsPair& b2){
+				return BoundsPair(Union(b1.first, b2.first), Union(b1.second, b2.second));
+			});
+	else
+		result = accumulate(tbb::blocked_range<int>(start, end), BoundsPair());
+	*bounds = result.first;
+	*centroidBounds = result.second;
+}
+
+struct BucketSet{
+	BucketInfo buckets[nBuckets];
+};
+
+static BucketSet computeBuckets(const std::vector<BVHPrimInfo>& primInfo, int start, int end,
+	const Bounds3f& centroidBounds, int splitDim){
+	auto accumulate = [&](const tbb::blocked_range<int>& r, BucketSet set){
+		for(int i=r.begin(); i<r.end(); ++i){
+			BucketInfo& bucket = set.buckets[bucketIndex(centroidBounds, primInfo[i].centroid, splitDim)];
+			bucket.primCount++;
+			bucket.bucketBounds = Union(bucket.bucketBounds, primInfo[i].bounds);
+		}
+		return set;
+	};
+	if(end - start <= ParallelReduceThreshold)
+		return accumulate(tbb::blocked_range<int>(start, end), BucketSet());
+	return tbb::parallel_reduce(tbb::blocked_range<int>(start, end), BucketSet(), accumulate,
+		[](BucketSet s1, const BucketSet& s2){
+			for(int i=0; i<nBuckets; ++i){
+				s1.buckets[i].primCount += s2.buckets[i].primCount;
+				s1.buckets[i].bucketBounds = Union(s1.buckets[i].bucketBounds, s2.buckets[i].bucketBounds);
+			}
+			return s1;
+		});
+}
+
+// find the bucket boundary with the lowest SAH cost, sweeping from the right once
+// and from the left once so all split costs are computed in O(nBuckets)
+static int minCostSplit(const BucketInfo* buckets, const Bounds3f& bounds, float* minCost){
+	Bounds3f rightBounds[nBuckets];
+	int rightCount[nBuckets];
+	rightBounds[nBuckets - 1] = buckets[nBuckets - 1].bucketBounds;
+	rightCount[nBuckets - 1] = buckets[nBuckets - 1].primCount;
+	for(int i=nBuckets-2; i>0; --i){
+		rightBounds[i] = Union(rightBounds[i + 1], buckets[i].bucketBounds);
+		rightCount[i] = rightCount[i + 1] + buckets[i].primCount;
+	}
+
+	*minCost = Infinity;
+	int minBucketIndex = -1;
+	float inv_wholeArea = 1.f / bounds.surfaceArea();
+	Bounds3f left_bounds;
+	int left_count = 0;
+	for(int i=0; i<nBuckets-1; ++i){
+		left_count += buckets[i].primCount;
+		left_bounds = Union(left_bounds, buckets[i].bucketBounds);
+		if(left_count == 0 || rightCount[i + 1] == 0)
+			continue;
+		float cost = (left_count * left_bounds.surfaceArea() 
+						+ rightCount[i + 1] * rightBounds[i + 1].surfaceArea()) * inv_wholeArea;
+		if(cost < *minCost){
+			*minCost = cost;
+			minBucketIndex = i;
+		}
+	}
+	return minBucketIndex;
+}
+
+// spread the lower 10 bits of x so that there are two zero bits between each of them
+static inline uint32_t leftShift3(uint32_t x){
+	if(x == (1 << 10)) --x;
+	x = (x | (x << 16)) & 0x30000ff;
+	x = (x | (x << 8)) & 0x300f00f;
+	x = (x | (x << 4)) & 0x30c30c3;
+	x = (x | (x << 2)) & 0x9249249;
+	return x;
+}
+
+static inline uint32_t encodeMorton3(const Vec3f& v){
+	return (leftShift3(v.z) << 2) | (leftShift3(v.y) << 1) | leftShift3(v.x);
+}
+
+// LSD radix sort on the 30-bit Morton codes, every pass counts and scatters chunks in parallel
+static void radixSort(std::vector<MortonPrimitive>* v){
+	constexpr int bitsPerPass = 6;
+	constexpr int nBits = 30;
+	constexpr int nPasses = nBits / bitsPerPass;
+	constexpr int nRadixBuckets = 1 << bitsPerPass;
+	constexpr int bitMask = nRadixBuckets - 1;
+	constexpr int chunkSize = 16384;
+
+	const int n = v->size();
+	const int nChunks = (n + chunkSize - 1) / chunkSize;
+	std::vector<MortonPrimitive> tempVector(n);
+	std::vector<std::array<int, nRadixBuckets>> offsets(nChunks);
+	for(int pass=0; pass<nPasses; ++pass){
+		const int lowBit = pass * bitsPerPass;
+		const std::vector<MortonPrimitive>& in = (pass & 1) ? tempVector : *v;
+		std::vector<MortonPrimitive>& out = (pass & 1) ? *v : tempVector;
+
+		tbb::parallel_for(0, nChunks, [&](int c){
+			offsets[c].fill(0);
+			for(int i=c*chunkSize; i<std::min(n, (c + 1) * chunkSize); ++i)
+				offsets[c][(in[i].mortonCode >> lowBit) & bitMask]++;
+		});
+		// chunks keep their relative order inside every bucket, so the sort stays stable
+		int sum = 0;
+		for(int b=0; b<nRadixBuckets; ++b)
+			for(int c=0; c<nChunks; ++c){
+				int count = offsets[c][b];
+				offsets[c][b] = sum;
+				sum += count;
+			}
+		tbb::parallel_for(0, nChunks, [&](int c){
+			for(int i=c*chunkSize; i<std::min(n, (c + 1) * chunkSize); ++i)
+				out[offsets[c][(in[i].mortonCode >> lowBit) & bitMask]++] = in[i];
+		});
+	}
+	if(nPasses & 1)
+		v->swap(tempVector);
+}
+
 BVH::BVH(std::vector<std::shared_ptr<Primitive>> prims, 
 		int maxPrimsInNode, SplitMethod method)
 		: Aggregate(std::move(prims)), 
@@ -12,138 +167,248 @@ BVH::BVH(std::vector<std::shared_ptr<Primitive>> prims,
 		  splitMethod(method){
 	if(primitives.empty())	return;
 
+	TICK_TBB(BVH_BUILD)
 	std::vector<BVHPrimInfo> primInfo(primitives.size());
-	for(size_t i=0; i<primitives.size(); ++i)
+	tbb::parallel_for(size_t(0), primitives.size(), [&](size_t i){
 		primInfo[i] = {i, primitives[i]->worldBound()};
+	});
 
-	std::vector<std::shared_ptr<Primitive>> orderedPrims;
-	orderedPrims.reserve(primitives.size());
-	int total_nodes = 0;
-	BVHNode* node = recursiveBuild(primInfo, &total_nodes, 0, primitives.size(), orderedPrims);
+	// leaves write their primitives to the slots of their own range, so subtrees can be built concurrently
+	std::vector<std::shared_ptr<Primitive>> orderedPrims(primitives.size());
+	BVHBuildArena arena(primitives.size());
+	BVHNode* node = (splitMethod == SplitMethod::HLBVH) 
+		? HLBVHBuild(arena, primInfo, orderedPrims)
+		: recursiveBuild(arena, primInfo, 0, primitives.size(), orderedPrims, 1);
 	primitives.swap(orderedPrims);
 	// construct a empty object to clear primInfo capacity
 	// std::vector<BVHPrimInfo>().swap(primInfo);
 	primInfo.resize(0);
 
-	root = new LinearBVHNode[total_nodes];
+	root = new LinearBVHNode[arena.totalNodes];
 	int offset = 0;
-	flattenBVHTree(node, &offset);
+	flattenBVHTree(node, &offset, 1);
+	if(maxDepth > MaxDepth)
+		throw("BVH is deeper than BVH::MaxDepth!");
+	TOCK_TBB(BVH_BUILD)
+	std::cout << "BVH depth: " << maxDepth << std::endl;
 }
 
 BVH::~BVH(){delete [] root;}
 
-BVHNode* BVH::recursiveBuild(std::vector<BVHPrimInfo>& primInfo, int* total_nodes,
-	int start, int end, std::vector<std::shared_ptr<Primitive>>& orderedPrims){
-	BVHNode* node = new BVHNode();
-	(*total_nodes)++;
+BVHNode* BVH::recursiveBuild(BVHBuildArena& arena, std::vector<BVHPrimInfo>& primInfo,
+	int start, int end, std::vector<std::shared_ptr<Primitive>>& orderedPrims, int depth){
+	BVHNode* node = arena.alloc();
 
-	Bounds3f bounds;
-	for(size_t i=start; i<end; ++i)
-		bounds = Union(bounds, primInfo[i].bounds);
+	Bounds3f bounds, centroidBounds;
+	computeBounds(primInfo, start, end, &bounds, &centroidBounds);
 	int nPrims = end - start;
-	// std::cout << *(total_nodes) << std::endl;
 
-	// 
-	if(nPrims == 1){
-		int firstPrimIndex = orderedPrims.size();
-		for(size_t i=start; i<end; ++i){
-			size_t index = primInfo[i].primIndex;
-			orderedPrims.push_back(primitives[index]);
-		}
-		node->initLeaf(firstPrimIndex, nPrims, bounds);
+	auto createLeaf = [&](){
+		for(int i=start; i<end; ++i)
+			orderedPrims[i] = primitives[primInfo[i].primIndex];
+		node->initLeaf(start, nPrims, bounds);
 		return node;
-	}else{
-		Bounds3f centroidBounds;
-		for(size_t i=start; i<end; ++i)
-			centroidBounds = Union(centroidBounds, primInfo[i].centroid);
-		int splitDim = centroidBounds.maxExtent();
-
-		//
-		if(centroidBounds.pMin[splitDim] == centroidBounds.pMax[splitDim]){
-			int firstPrimIndex = orderedPrims.size();
-			for(size_t i=start; i<end; ++i){
-				size_t index = primInfo[i].primIndex;
-				orderedPrims.push_back(primitives[index]);
-			}
-			node->initLeaf(firstPrimIndex, nPrims, bounds);	
-			return node;		
-		}else{
-			int mid = (start + end) / 2;
-			switch(splitMethod) {
-				case SplitMethod::Middle:	break;
-				case SplitMethod::EqualCounts : break;
-				case SplitMethod::SAH:
-				default:{
-					if(nPrims <= 4){
+	};
+
+	// 
+	if(nPrims == 1)
+		return createLeaf();
+
+	int splitDim = centroidBounds.maxExtent();
+	//
+	if(centroidBounds.pMin[splitDim] == centroidBounds.pMax[splitDim])
+		return createLeaf();
+
+	int mid = (start + end) / 2;
+	auto equalCountsSplit = [&](){
+		std::nth_element(&primInfo[start], &primInfo[mid], &primInfo[end-1] + 1, 
+			[splitDim](const BVHPrimInfo& p1, const BVHPrimInfo& p2){
+				return p1.centroid[splitDim] < p2.centroid[splitDim];
+			});
+	};
+	SplitMethod method = (depth >= EqualCountsDepth) ? SplitMethod::EqualCounts : splitMethod;
+	switch(method) {
+		case SplitMethod::Middle:	break;
+		case SplitMethod::EqualCounts :
+			equalCountsSplit();
+			break;
+		case SplitMethod::SAH:
+		default:{
+			if(nPrims <= 4){
+				equalCountsSplit();
+			}else{
+				BucketSet set = computeBuckets(primInfo, start, end, centroidBounds, splitDim);
+				float minCost;
+				int minBucketIndex = minCostSplit(set.buckets, bounds, &minCost);
+
+				float leafCost = nPrims;
+				if(nPrims > maxPrimsInNode || minCost < leafCost){
+					BVHPrimInfo* pmid = std::partition(&primInfo[start], &primInfo[end-1] + 1, 
+							[=](const BVHPrimInfo& info){
+								return bucketIndex(centroidBounds, info.centroid, splitDim) <= minBucketIndex;
+						});
+					mid = pmid - (&primInfo[0]);
+					// degenerate centroids may put every primitive in one side
+					if(mid == start || mid == end){
 						mid = (start + end) / 2;
-						std::nth_element(&primInfo[start], &primInfo[mid], &primInfo[end-1] + 1, 
-							[splitDim](const BVHPrimInfo& p1, const BVHPrimInfo& p2){
-								return p1.centroid[splitDim] < p2.centroid[splitDim];
-							});
-					}else{
-						constexpr int nBuckets = 12;
-						BucketInfo buckets[nBuckets];
-
-						// 
-						for(size_t i=start; i<end; ++i){
-							int bucket_index = static_cast<int>(nBuckets * 
-								centroidBounds.offset(primInfo[i].centroid)[splitDim]);
-							if(bucket_index == nBuckets)
-								bucket_index = nBuckets - 1;
-							buckets[bucket_index].primCount++;
-							buckets[bucket_index].bucketBounds 
-								= Union(buckets[bucket_index].bucketBounds, primInfo[i].bounds);
-						}
-
-						float minCost = Infinity;
-						int minBucketIndex = -1;
-						float inv_wholeArea = 1.f / bounds.surfaceArea();
-						for(size_t i=0; i<nBuckets-1; ++i){
-							Bounds3f left_bounds, right_bounds;
-							int left_count = 0, right_count = 0;
-							for(size_t j=0; j<=i; ++j){
-								left_count += buckets[j].primCount;
-								left_bounds = Union(left_bounds, buckets[j].bucketBounds);
-							}
-							for(size_t j=i+1; j<nBuckets; ++j){
-								right_count += buckets[j].primCount;
-								right_bounds = Union(right_bounds, buckets[j].bucketBounds);
-							}
-							float cost = (left_count * left_bounds.surfaceArea() 
-											+ right_count * right_bounds.surfaceArea()) * inv_wholeArea;
-							if(cost < minCost){
-								minCost = cost;
-								minBucketIndex = i;
-							}
-						}
-
-						float leafCost = nPrims;
-						if(nPrims > maxPrimsInNode || minCost < leafCost){
-							BVHPrimInfo* pmid = std::partition(&primInfo[start], &primInfo[end-1] + 1, 
-									[=](const BVHPrimInfo& info){
-										int bucket_index = static_cast<int>(nBuckets * 
-											centroidBounds.offset(info.centroid)[splitDim]);
-										return bucket_index <= minBucketIndex;
-								});
-							mid = pmid - (&primInfo[0]);
-						}else{
-							int firstPrimIndex = orderedPrims.size();
-							for(size_t i=start; i<end; ++i){
-								size_t index = primInfo[i].primIndex;
-								orderedPrims.push_back(primitives[index]);
-							}
-							node->initLeaf(firstPrimIndex, nPrims, bounds);	
-							return node;						
-						}
+						equalCountsSplit();
 					}
-					break;
+				}else{
+					return createLeaf();
 				}
 			}
-			node->initInterior(splitDim, 
-				recursiveBuild(primInfo, total_nodes, start, mid, orderedPrims),
-				recursiveBuild(primInfo, total_nodes, mid, end, orderedPrims));
+			break;
+		}
+	}
+
+	BVHNode *left, *right;
+	if(nPrims > ParallelBuildThreshold)
+		tbb::parallel_invoke(
+			[&](){ left = recursiveBuild(arena, primInfo, start, mid, orderedPrims, depth + 1); },
+			[&](){ right = recursiveBuild(arena, primInfo, mid, end, orderedPrims, depth + 1); });
+	else{
+		left = recursiveBuild(arena, primInfo, start, mid, orderedPrims, depth + 1);
+		right = recursiveBuild(arena, primInfo, mid, end, orderedPrims, depth + 1);
+	}
+	node->initInterior(splitDim, left, right);
+	return node;
+}
+
+BVHNode* BVH::HLBVHBuild(BVHBuildArena& arena, const std::vector<BVHPrimInfo>& primInfo,
+	std::vector<std::shared_ptr<Primitive>>& orderedPrims) const{
+	Bounds3f bounds, centroidBounds;
+	computeBounds(primInfo, 0, primInfo.size(), &bounds, &centroidBounds);
+
+	// quantize centroids to a 2^10 grid per axis and compute their Morton codes
+	constexpr int mortonBits = 10;
+	constexpr int mortonScale = 1 << mortonBits;
+	const Vec3f extent = centroidBounds.diagnoal();
+	std::vector<MortonPrimitive> mortonPrims(primInfo.size());
+	tbb::parallel_for(size_t(0), primInfo.size(), [&](size_t i){
+		Vec3f offset = primInfo[i].centroid - centroidBounds.pMin;
+		for(int a=0; a<3; ++a)
+			offset[a] = extent[a] > 0.f ? offset[a] / extent[a] * mortonScale : 0.f;
+		mortonPrims[i].primIndex = i;
+		mortonPrims[i].mortonCode = encodeMorton3(offset);
+	});
+	radixSort(&mortonPrims);
+
+	// primitives sharing the 12 high bits of their Morton code form one treelet
+	std::vector<LBVHTreelet> treeletsToBuild;
+	constexpr uint32_t treeletMask = 0b00111111111111000000000000000000;
+	for(int start=0, end=1; end<=(int)mortonPrims.size(); ++end){
+		if(end == (int)mortonPrims.size() || 
+			(mortonPrims[start].mortonCode & treeletMask) != (mortonPrims[end].mortonCode & treeletMask)){
+			treeletsToBuild.push_back({start, end - start, nullptr});
+			start = end;
+		}
+	}
+
+	// build the treelets in parallel, leaves fill orderedPrims at their Morton order position
+	constexpr int firstBitIndex = 29 - 12;
+	tbb::parallel_for(size_t(0), treeletsToBuild.size(), [&](size_t i){
+		LBVHTreelet& tr = treeletsToBuild[i];
+		tr.buildNodes = emitLBVH(arena, primInfo, &mortonPrims[tr.startIndex], 
+			tr.startIndex, tr.nPrimitives, orderedPrims, firstBitIndex);
+	});
+
+	// connect the treelets with a SAH built upper tree
+	std::vector<BVHNode*> treeletRoots;
+	treeletRoots.reserve(treeletsToBuild.size());
+	for(const LBVHTreelet& tr : treeletsToBuild)
+		treeletRoots.push_back(tr.buildNodes);
+	return buildUpperSAH(arena, treeletRoots, 0, treeletRoots.size(), 1);
+}
+
+BVHNode* BVH::emitLBVH(BVHBuildArena& arena, const std::vector<BVHPrimInfo>& primInfo,
+	const MortonPrimitive* mortonPrims, int firstPrimIndex, int nPrims,
+	std::vector<std::shared_ptr<Primitive>>& orderedPrims, int bitIndex) const{
+	if(bitIndex == -1 || nPrims <= maxPrimsInNode){
+		BVHNode* node = arena.alloc();
+		Bounds3f bounds;
+		for(int i=0; i<nPrims; ++i){
+			const BVHPrimInfo& info = primInfo[mortonPrims[i].primIndex];
+			orderedPrims[firstPrimIndex + i] = primitives[info.primIndex];
+			bounds = Union(bounds, info.bounds);
+		}
+		node->initLeaf(firstPrimIndex, nPrims, bounds);
+		return node;
+	}
+
+	// skip bits that do not separate the primitives of this range
+	int mask = 1 << bitIndex;
+	if((mortonPrims[0].mortonCode & mask) == (mortonPrims[nPrims - 1].mortonCode & mask))
+		return emitLBVH(arena, primInfo, mortonPrims, firstPrimIndex, nPrims, 
+			orderedPrims, bitIndex - 1);
+
+	// binary search the first primitive whose bit is set
+	int searchStart = 0, searchEnd = nPrims - 1;
+	while(searchStart + 1 != searchEnd){
+		int mid = (searchStart + searchEnd) / 2;
+		if((mortonPrims[searchStart].mortonCode & mask) == (mortonPrims[mid].mortonCode & mask))
+			searchStart = mid;
+		else
+			searchEnd = mid;
+	}
+	int splitOffset = searchEnd;
+
+	BVHNode* node = arena.alloc();
+	BVHNode* left = emitLBVH(arena, primInfo, mortonPrims, firstPrimIndex, splitOffset, 
+		orderedPrims, bitIndex - 1);
+	BVHNode* right = emitLBVH(arena, primInfo, &mortonPrims[splitOffset], firstPrimIndex + splitOffset,
+		nPrims - splitOffset, orderedPrims, bitIndex - 1);
+	// Morton bits cycle through x, y, z from the lowest bit upwards
+	node->initInterior(bitIndex % 3, left, right);
+	return node;
+}
+
+BVHNode* BVH::buildUpperSAH(BVHBuildArena& arena, std::vector<BVHNode*>& treeletRoots,
+	int start, int end, int depth) const{
+	int nNodes = end - start;
+	if(nNodes == 1)
+		return treeletRoots[start];
+
+	BVHNode* node = arena.alloc();
+	Bounds3f bounds, centroidBounds;
+	for(int i=start; i<end; ++i){
+		bounds = Union(bounds, treeletRoots[i]->bounds);
+		centroidBounds = Union(centroidBounds, 0.5f * (treeletRoots[i]->bounds.pMin + treeletRoots[i]->bounds.pMax));
+	}
+	int splitDim = centroidBounds.maxExtent();
+
+	auto nodeCentroid = [](const BVHNode* n){
+		return 0.5f * (n->bounds.pMin + n->bounds.pMax);
+	};
+
+	int mid = (start + end) / 2;
+	if(depth >= UpperSAHEqualCountsDepth){
+		std::nth_element(&treeletRoots[start], &treeletRoots[mid], &treeletRoots[end - 1] + 1,
+			[&](const BVHNode* n1, const BVHNode* n2){
+				return nodeCentroid(n1)[splitDim] < nodeCentroid(n2)[splitDim];
+			});
+	}else if(centroidBounds.pMax[splitDim] > centroidBounds.pMin[splitDim]){
+		auto nodeBucket = [&](const BVHNode* n){
+			return bucketIndex(centroidBounds, nodeCentroid(n), splitDim);
+		};
+		BucketInfo buckets[nBuckets];
+		for(int i=start; i<end; ++i){
+			BucketInfo& bucket = buckets[nodeBucket(treeletRoots[i])];
+			bucket.primCount++;
+			bucket.bucketBounds = Union(bucket.bucketBounds, treeletRoots[i]->bounds);
 		}
+		float minCost;
+		int minBucketIndex = minCostSplit(buckets, bounds, &minCost);
+		BVHNode** pmid = std::partition(&treeletRoots[start], &treeletRoots[end - 1] + 1,
+			[&](const BVHNode* n){
+				return nodeBucket(n) <= minBucketIndex;
+			});
+		if(pmid != &treeletRoots[start] && pmid != &treeletRoots[end - 1] + 1)
+			mid = pmid - &treeletRoots[0];
 	}
+
+	node->initInterior(splitDim, 
+		buildUpperSAH(arena, treeletRoots, start, mid, depth + 1),
+		buildUpperSAH(arena, treeletRoots, mid, end, depth + 1));
 	return node;
 }
 
@@ -151,17 +416,18 @@ Bounds3f BVH::worldBound() const{
 	return root ? root->bounds : Bounds3f();
 }
 
-int BVH::flattenBVHTree(BVHNode* node, int* offset){
+int BVH::flattenBVHTree(BVHNode* node, int* offset, int depth){
 	LinearBVHNode* linearNode = &root[*offset];
 	int cur_offset = (*offset)++;
+	maxDepth = std::max(maxDepth, depth);
 	linearNode->bounds = node->bounds;
 	linearNode->nPrimitives = node->nPrimitive;
 	if(node->nPrimitive > 0){
 		linearNode->primIndex = node->firstPrimIndex;
 	}else{
 		linearNode->splitDim = node->splitAxis;
-		flattenBVHTree(node->children[0], offset);
-		linearNode->rightChildOffset = flattenBVHTree(node->children[1], offset);
+		flattenBVHTree(node->children[0], offset, depth + 1);
+		linearNode->rightChildOffset = flattenBVHTree(node->children[1], offset, depth + 1);
 	}
 	return cur_offset;
 }
@@ -175,12 +441,12 @@ bool BVH::intersect(const Ray& ray, SurfaceInteraction* isect) const{
 	const bool isDirNeg[3] = {ray.dir.x < 0.f, ray.dir.y < 0.f, ray.dir.z < 0.f};
 
 	bool hit = false;
-	int curOffset = 0;
-	std::stack<int> need2Test;
-	need2Test.push(curOffset);
-	while(!need2Test.empty()){
-		curOffset = need2Test.top();
-		need2Test.pop();
+	// a node's box is tested when it is popped, against the ray.tMax of that moment
+	int need2Test[MaxDepth + 1];
+	int top = 0;
+	need2Test[top++] = 0;
+	while(top > 0){
+		int curOffset = need2Test[--top];
 		const LinearBVHNode* curNode = &root[curOffset];
 
 		if(!curNode->bounds.intersectP(ray, invDir, isDirNeg)){
@@ -191,12 +457,13 @@ bool BVH::intersect(const Ray& ray, SurfaceInteraction* isect) const{
 					if(primitives[curNode->primIndex + i]->intersect(ray, isect))
 						hit = true;
 			}else{
+				// push the far child first so the near one is popped next
 				if(isDirNeg[curNode->splitDim]){
-					need2Test.push(curNode->rightChildOffset);
-					need2Test.push(curOffset + 1);
+					need2Test[top++] = curOffset + 1;
+					need2Test[top++] = curNode->rightChildOffset;
 				}else{
-					need2Test.push(curOffset + 1);
-					need2Test.push(curNode->rightChildOffset);
+					need2Test[top++] = curNode->rightChildOffset;
+					need2Test[top++] = curOffset + 1;
 				}
 			}
 		}
@@ -205,30 +472,44 @@ bool BVH::intersect(const Ray& ray, SurfaceInteraction* isect) const{
 }
 
 bool BVH::intersectP(const Ray& ray) const{
+	const Primitive* occluder;
+	return intersectP(ray, &occluder);
+}
+
+bool BVH::intersectP(const Ray& ray, const Primitive** occluder) const{
 	if(root == nullptr)
 		return false;
 
 	const Vec3f invDir(1.f / ray.dir.x, 1.f / ray.dir.y, 1.f / ray.dir.z);
 	const bool isDirNeg[3] = {ray.dir.x < 0.f, ray.dir.y < 0.f, ray.dir.z < 0.f};
 
-	int curOffset = 0;
-	std::stack<int> need2Test;
-	need2Test.push(curOffset);
-	while(!need2Test.empty()){
-		curOffset = need2Test.top();
-		need2Test.pop();
+	int need2Test[MaxDepth + 1];
+	int top = 0;
+	need2Test[top++] = 0;
+	while(top > 0){
+		int curOffset = need2Test[--top];
 		const LinearBVHNode* curNode = &root[curOffset];
 
 		if(!curNode->bounds.intersectP(ray, invDir, isDirNeg)){
 			continue;
 		}else{
 			if(curNode->nPrimitives > 0){
-				for(int i = 0; i < curNode->nPrimitives; ++i)
-					if(primitives[i + curNode->primIndex]->intersectP(ray))
+				for(int i = 0; i < curNode->nPrimitives; ++i){
+					const Primitive* prim = primitives[i + curNode->primIndex].get();
+					if(prim->intersectP(ray)){
+						*occluder = prim;
 						return true;
+					}
+				}
 			}else{
-				need2Test.push(curOffset+1);
-				need2Test.push(curNode->rightChildOffset);
+				// same near to far order as intersect, occluders close to the origin are found early
+				if(isDirNeg[curNode->splitDim]){
+					need2Test[top++] = curOffset + 1;
+					need2Test[top++] = curNode->rightChildOffset;
+				}else{
+					need2Test[top++] = curNode->rightChildOffset;
+					need2Test[top++] = curOffset + 1;
+				}
 			}
 		}
 	}
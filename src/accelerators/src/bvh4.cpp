@@ -0,0 +1,109 @@
+#include <accelerators/bvh4.h>
+
+RIGA_NAMESPACE_BEGIN
+
+BVH4::BVH4(std::vector<std::shared_ptr<Primitive>> prims,
+		int maxPrimsInNode, SplitMethod method)
+		: BVH(std::move(prims), maxPrimsInNode, method){
+	if(root == nullptr)	return;
+
+	bounds = root->bounds;
+	if(root->nPrimitives > 0){
+		const int rootChildren[1] = {0};
+		collapse(rootChildren, 1);
+	}else{
+		const int rootChildren[2] = {1, root->rightChildOffset};
+		collapse(rootChildren, 2);
+	}
+
+	// the binary nodes are not needed after collapsing
+	delete [] root;
+	root = nullptr;
+}
+
+int BVH4::collapse(const int* binaryChildren, int nChildren){
+	// open the largest interior child until the node has four children
+	int children[4];
+	for(int i=0; i<nChildren; ++i)
+		children[i] = binaryChildren[i];
+	while(nChildren < 4){
+		int best = -1;
+		float bestArea = -1.f;
+		for(int i=0; i<nChildren; ++i){
+			const LinearBVHNode& child = root[children[i]];
+			if(child.nPrimitives == 0 && child.bounds.surfaceArea() > bestArea){
+				best = i;
+				bestArea = child.bounds.surfaceArea();
+			}
+		}
+		if(best == -1)
+			break;
+		const int opened = children[best];
+		children[best] = opened + 1;
+		children[nChildren++] = root[opened].rightChildOffset;
+	}
+
+	const int nodeOffset = nodes.size();
+	nodes.emplace_back();
+	for(int i=0; i<4; ++i){
+		Bounds3f b;
+		int child = -1, nPrims = 0;
+		if(i < nChildren){
+			const LinearBVHNode& binaryNode = root[children[i]];
+			b = binaryNode.bounds;
+			if(binaryNode.nPrimitives > 0){
+				child = binaryNode.primIndex;
+				nPrims = binaryNode.nPrimitives;
+			}else{
+				const int grandChildren[2] = {children[i] + 1, binaryNode.rightChildOffset};
+				child = collapse(grandChildren, 2);
+			}
+		}
+		// nodes may be reallocated by the recursion above
+		BVH4Node& node = nodes[nodeOffset];
+		for(int a=0; a<3; ++a){
+			node.bounds[0][a][i] = b.pMin[a];
+			node.bounds[1][a][i] = b.pMax[a];
+		}
+		node.children[i] = child;
+		node.nPrimitives[i] = nPrims;
+	}
+	return nodeOffset;
+}
+
+Bounds3f BVH4::worldBound() const{
+	return bounds;
+}
+
+bool BVH4::intersect(const Ray& ray, SurfaceInteraction* isect) const{
+	bool hit = false;
+	traverse<true>(ray, [&](int primIndex, int nPrims){
+		for(int i = 0; i < nPrims; ++i)
+			if(primitives[primIndex + i]->intersect(ray, isect))
+				hit = true;
+		return false;
+	});
+	return hit;
+}
+
+bool BVH4::intersectP(const Ray& ray) const{
+	const Primitive* occluder;
+	return intersectP(ray, &occluder);
+}
+
+bool BVH4::intersectP(const Ray& ray, const Primitive** occluder) const{
+	bool hit = false;
+	traverse<false>(ray, [&](int primIndex, int nPrims){
+		for(int i = 0; i < nPrims; ++i){
+			const Primitive* prim = primitives[primIndex + i].get();
+			if(prim->intersectP(ray)){
+				*occluder = prim;
+				return hit = true;
+			}
+		}
+		return false;
+	});
+	return hit;
+}
+
+RIGA_NAMESPACE_END
@@ -0,0 +1,170 @@
+#include <accelerators/trianglebvh4.h>
+#include <shapes/triangle.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// Moller Trumbore against the four lanes of block, evaluated in the same order as
+// Triangle::intersect so both agree on every hit. returns a bit mask of hit lanes
+static inline int intersectBlock(const TriangleBlock4& block, const Ray& ray, float tHit[4]){
+#ifdef RIGA_BVH4_SSE
+	const __m128 dx = _mm_set1_ps(ray.dir.x), dy = _mm_set1_ps(ray.dir.y), dz = _mm_set1_ps(ray.dir.z);
+	const __m128 e1x = _mm_load_ps(block.e1[0]), e1y = _mm_load_ps(block.e1[1]), e1z = _mm_load_ps(block.e1[2]);
+	const __m128 e2x = _mm_load_ps(block.e2[0]), e2y = _mm_load_ps(block.e2[1]), e2z = _mm_load_ps(block.e2[2]);
+
+	// s1 = Cross(dir, e2), det = Dot(e1, s1)
+	const __m128 s1x = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	const __m128 s1y = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	const __m128 s1z = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, s1x), _mm_mul_ps(e1y, s1y)), _mm_mul_ps(e1z, s1z));
+	__m128 valid = _mm_or_ps(_mm_cmple_ps(det, _mm_set1_ps(-1e-8f)), _mm_cmpge_ps(det, _mm_set1_ps(1e-8f)));
+	const __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+
+	// s = o - v0, u = Dot(s, s1) / det
+	const __m128 sx = _mm_sub_ps(_mm_set1_ps(ray.o.x), _mm_load_ps(block.v0[0]));
+	const __m128 sy = _mm_sub_ps(_mm_set1_ps(ray.o.y), _mm_load_ps(block.v0[1]));
+	const __m128 sz = _mm_sub_ps(_mm_set1_ps(ray.o.z), _mm_load_ps(block.v0[2]));
+	const __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, s1x), _mm_mul_ps(sy, s1y)),
+		_mm_mul_ps(sz, s1z)), invDet);
+
+	// s2 = Cross(s, e1), v = Dot(s2, dir) / det, t = Dot(s2, e2) / det
+	const __m128 s2x = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	const __m128 s2y = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	const __m128 s2z = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	const __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s2x, dx), _mm_mul_ps(s2y, dy)),
+		_mm_mul_ps(s2z, dz)), invDet);
+	const __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(s2x, e2x), _mm_mul_ps(s2y, e2y)),
+		_mm_mul_ps(s2z, e2z)), invDet);
+
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+	valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+	valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+	valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmple_ps(t, _mm_set1_ps(ray.tMax)),
+		_mm_cmpge_ps(t, _mm_set1_ps(ray.tMin))));
+	_mm_storeu_ps(tHit, t);
+	return _mm_movemask_ps(valid);
+#else
+	int mask = 0;
+	for(int i=0; i<4; ++i){
+		const Vec3f e1(block.e1[0][i], block.e1[1][i], block.e1[2][i]);
+		const Vec3f e2(block.e2[0][i], block.e2[1][i], block.e2[2][i]);
+		Vec3f s1 = Cross(ray.dir, e2);
+		float det = Dot(e1, s1);
+		if(det > -1e-8f && det < 1e-8f)
+			continue;
+		float inv_det = 1.f / det;
+		Vec3f s = ray.o - Point3f(block.v0[0][i], block.v0[1][i], block.v0[2][i]);
+		float u = Dot(s, s1) * inv_det;
+		Vec3f s2 = Cross(s, e1);
+		float v = Dot(s2, ray.dir) * inv_det;
+		float t = Dot(s2, e2) * inv_det;
+		if(u >= 0.f && u <= 1.f && v >= 0.f && u + v <= 1.f && t <= ray.tMax && t >= ray.tMin){
+			tHit[i] = t;
+			mask |= (1 << i);
+		}
+	}
+	return mask;
+#endif
+}
+
+TriangleBVH4::TriangleBVH4(std::vector<std::shared_ptr<Primitive>> prims,
+		int maxPrimsInNode, SplitMethod method)
+		: BVH4(std::move(prims), maxPrimsInNode, method){
+	// replace the primitive ranges of the leaves by ranges of triangle blocks
+	for(BVH4Node& node : nodes){
+		for(int c=0; c<4; ++c){
+			if(node.nPrimitives[c] == 0)
+				continue;
+			const int primIndex = node.children[c], nPrims = node.nPrimitives[c];
+			const int firstBlock = blocks.size();
+			for(int i=0; i<nPrims; ++i){
+				const int lane = i % 4;
+				if(lane == 0){
+					blocks.emplace_back();
+					TriangleBlock4& block = blocks.back();
+					memset(&block, 0, sizeof(TriangleBlock4));
+					for(int l=0; l<4; ++l)
+						block.primIndex[l] = -1;
+				}
+				TriangleBlock4& block = blocks.back();
+				block.primIndex[lane] = primIndex + i;
+
+				const GeometricPrimitive* gp = dynamic_cast<const GeometricPrimitive*>(primitives[primIndex + i].get());
+				const Triangle* tri = gp ? dynamic_cast<const Triangle*>(gp->getShape()) : nullptr;
+				if(tri == nullptr){
+					block.genericMask |= (1 << lane);
+					continue;
+				}
+				Point3f p[3];
+				tri->getVertices(p);
+				const Vec3f e1 = p[1] - p[0], e2 = p[2] - p[0];
+				for(int a=0; a<3; ++a){
+					block.v0[a][lane] = p[0][a];
+					block.e1[a][lane] = e1[a];
+					block.e2[a][lane] = e2[a];
+				}
+			}
+			node.children[c] = firstBlock;
+			node.nPrimitives[c] = blocks.size() - firstBlock;
+		}
+	}
+}
+
+bool TriangleBVH4::intersect(const Ray& ray, SurfaceInteraction* isect) const{
+	const float tMax = ray.tMax;
+	bool hit = false;
+	// closest triangle found so far, its SurfaceInteraction is filled after traversal
+	int closest = -1;
+	traverse<true>(ray, [&](int firstBlock, int nBlocks){
+		for(int b=firstBlock; b<firstBlock+nBlocks; ++b){
+			const TriangleBlock4& block = blocks[b];
+			float t[4];
+			int mask = intersectBlock(block, ray, t);
+			for(int i=0; i<4; ++i){
+				if(block.genericMask & (1 << i)){
+					if(primitives[block.primIndex[i]]->intersect(ray, isect)){
+						hit = true;
+						closest = -1;
+					}
+				}else if((mask & (1 << i)) && t[i] <= ray.tMax){
+					ray.tMax = t[i];
+					closest = block.primIndex[i];
+					hit = true;
+				}
+			}
+		}
+		return false;
+	});
+
+	if(closest >= 0){
+		ray.tMax = tMax;
+		return primitives[closest]->intersect(ray, isect);
+	}
+	return hit;
+}
+
+bool TriangleBVH4::intersectP(const Ray& ray) const{
+	const Primitive* occluder;
+	return intersectP(ray, &occluder);
+}
+
+bool TriangleBVH4::intersectP(const Ray& ray, const Primitive** occluder) const{
+	bool hit = false;
+	traverse<false>(ray, [&](int firstBlock, int nBlocks){
+		for(int b=firstBlock; b<firstBlock+nBlocks; ++b){
+			const TriangleBlock4& block = blocks[b];
+			float t[4];
+			const int mask = intersectBlock(block, ray, t) & ~block.genericMask;
+			for(int i=0; i<4; ++i){
+				if((mask & (1 << i)) || ((block.genericMask & (1 << i)) 
+						&& primitives[block.primIndex[i]]->intersectP(ray))){
+					*occluder = primitives[block.primIndex[i]].get();
+					return hit = true;
+				}
+			}
+		}
+		return false;
+	});
+	return hit;
+}
+
+RIGA_NAMESPACE_END
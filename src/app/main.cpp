@@ -7,25 +7,68 @@
 #include <core/common.h>
 #include <shapes/sphere.h>
 #include <shapes/triangle.h>
-#include <accelerators/bvh.h>
+#include <accelerators/trianglebvh4.h>
 #include <core/spectrum.h>
 #include <core/scene.h>
 #include <cameras/perspective.h>
 #include <cameras/orthographic.h>
 #include <samplers/halton.h>
+#include <samplers/sobol.h>
+#include <samplers/zerotwosequence.h>
+#include <samplers/stratified.h>
+#include <filters/box.h>
+#include <filters/gaussian.h>
+#include <filters/mitchell.h>
+#include <filters/blackmanharris.h>
 #include <core/integrator.h>
 #include <core/film.h>
+#include <core/denoiser.h>
 #include <textures/constant.h>
 #include <materials/matte.h>
 #include <lights/point.h>
 #include <lights/diffuse.h>
 #include <integrators/whitted.h>
+#include <integrators/path.h>
+#include <integrators/wavefront.h>
 #include <materials/mirror.h>
 #include <materials/glass.h>
 
 using namespace riga;
 
-void OBJ_loader_BVH_test(int width, int height){
+// sampler by name : halton (default), sobol, zerotwo or stratified, a "-bluenoise" suffix
+// decorrelates the pixels with a blue noise tile (e.g. halton-bluenoise)
+std::shared_ptr<Sampler> createSampler(const std::string& name, int spp, const Bounds2i& imageBound){
+	const std::string suffix = "-bluenoise";
+	if(name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0){
+		std::shared_ptr<Sampler> sampler = createSampler(name.substr(0, name.size() - suffix.size()), spp, imageBound);
+		sampler->setBlueNoise(true);
+		return sampler;
+	}
+	if(name == "sobol")
+		return std::make_shared<SobolSampler>(spp);
+	if(name == "zerotwo")
+		return std::make_shared<ZeroTwoSequenceSampler>(spp);
+	if(name == "stratified"){
+		int nx = std::max(1, (int)std::sqrt((float)spp));
+		return std::make_shared<StratifiedSampler>(nx, (spp + nx - 1) / nx);
+	}
+	return std::make_shared<HaltonSampler>(spp, imageBound, false);
+}
+
+// filter by name : box (default), gaussian, mitchell or blackmanharris
+std::unique_ptr<Filter> createFilter(const std::string& name){
+	if(name == "gaussian")
+		return std::make_unique<GaussianFilter>();
+	if(name == "mitchell")
+		return std::make_unique<MitchellFilter>();
+	if(name == "blackmanharris")
+		return std::make_unique<BlackmanHarrisFilter>();
+	return std::make_unique<BoxFilter>();
+}
+
+void OBJ_loader_BVH_test(int width, int height, const std::string& samplerName, 
+	const std::string& filterName, const std::string& checkpointFile, bool denoise, 
+	const std::string& lightDistribution, const std::string& integratorName){
 
 	// Materials
 	float bunny_color[3] = {0.2f, 0.5f, 0.4f};
@@ -159,7 +202,7 @@ void OBJ_loader_BVH_test(int width, int height){
 	}
 		
 	// Aggragate and Scenes
-	std::unique_ptr<Aggregate> agg = std::make_unique<BVH>(prims);
+	std::unique_ptr<Aggregate> agg = std::make_unique<TriangleBVH4>(prims);
 	std::unique_ptr<Scene> scene = std::make_unique<Scene>(std::move(agg), lights);
 
 	// get camera
@@ -168,13 +211,30 @@ void OBJ_loader_BVH_test(int width, int height){
 	Transform lookAt = LookAt(eye, look, up);
 	Transform cam2wor = Inverse(lookAt);
 	float fov = 90.f;
-	std::unique_ptr<Film> film = std::make_unique<Film>(Point2i(width, height), "whitted_test_mirror.ppm");
+	std::unique_ptr<Film> film = std::make_unique<Film>(Point2i(width, height), "whitted_test_mirror.ppm", 
+		createFilter(filterName));
+	if(denoise)
+		film->setDenoiser(std::make_unique<Denoiser>());
 	std::shared_ptr<Camera> cam(CreatePerspectiveCamera(cam2wor, fov, film.get()));
 
 	// get sampler and integrator
 	Bounds2i imageBound(Point2i(0, 0), Point2i(width, height));
-	std::shared_ptr<Sampler> halsamp = std::make_shared<HaltonSampler>(64, imageBound, false);
-	std::shared_ptr<Integrator> integrator = std::make_shared<WhittedIntegrator>(5, cam, halsamp);
+	std::shared_ptr<Sampler> sampler = createSampler(samplerName, 64, imageBound);
+	if(integratorName == "wavefront"){
+		// neither checkpoints nor the denoiser's AOVs
+		WavefrontPathIntegrator wavefront(5, cam, sampler);
+		wavefront.setLightDistribution(lightDistribution);
+		wavefront.render(*scene);
+		return;
+	}
+	std::shared_ptr<SamplerIntegrator> integrator;
+	if(integratorName == "path")
+		integrator = std::make_shared<PathIntegrator>(5, cam, sampler);
+	else
+		integrator = std::make_shared<WhittedIntegrator>(5, cam, sampler);
+	if(!checkpointFile.empty())
+		integrator->setCheckpoint(checkpointFile);
+	integrator->setLightDistribution(lightDistribution);
 	integrator->render(*scene);
 }
 
@@ -182,6 +242,9 @@ int main(int argc, char const *argv[])
 {
 	// **********************LEFT HAND COORDINATE**********************************
 	std::cout << "Hello Rider!" << std::endl;
-	OBJ_loader_BVH_test(800, 800);
+	// Rider [sampler] [filter] [checkpoint file] [denoise] [light distribution] [whitted | path | wavefront]
+	OBJ_loader_BVH_test(800, 800, argc > 1 ? argv[1] : "halton", argc > 2 ? argv[2] : "box", 
+		argc > 3 ? argv[3] : "", argc > 4 && std::string(argv[4]) == "denoise", argc > 5 ? argv[5] : "",
+		argc > 6 ? argv[6] : "whitted");
 	return 0;
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <tbb/tick_count.h>
 #include <numeric>
 #include <vector>
+#include <memory>
+#include <cstring>
 
 #define RIGA_NAMESPACE_BEGIN namespace riga {
 #define RIGA_NAMESPACE_END }
@@ -75,6 +77,8 @@ class Light;
 class AreaLight;
 class VisibilityTester;
 
+class MemoryArena;
+
 template <class T>
 bool isNaN(const T x){
 	return std::isnan(x);
@@ -125,6 +129,21 @@ inline int CountTrailingZeros(uint32_t v) {
 #endif
 }
 
+inline bool IsPowerOf2(int64_t v){
+	return v > 0 && !(v & (v - 1));
+}
+
+inline int64_t RoundUpPow2(int64_t v){
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+	v |= v >> 32;
+	return v + 1;
+}
+
 inline float Gamma(int n){
 	return (n * MachineEpsilon) / (1 - n * MachineEpsilon);
 }
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <core/common.h>
+#include <core/spectrum.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// per pixel guides of the denoiser, one plane per channel, row by row. pixels whose camera
+// rays hit nothing have a zero normal. variance is the one of the pixel's mean luminance, 
+// negative where it is unknown
+struct DenoiserFeatures{
+	DenoiserFeatures(int width, int height);
+
+	const int width, height;
+	std::vector<float> albedo[3], normal[3], depth, variance;
+};
+
+// edge avoiding a-trous wavelet filter (Dammertz et al.) with the edge stopping functions
+// of SVGF (Schied et al.) : the radiance is divided by the albedo, the irradiance is blurred
+// by iterations of a 5x5 B3 spline kernel whose taps lie 1, 2, 4 ... pixels apart, and the
+// albedo is multiplied back in. a tap is weighted down by the difference of its normal, its
+// depth and its luminance (relative to the standard deviation of the luminance, filtered 
+// along with the image) to the center pixel. the image is processed in planes of floats,
+// rows in parallel
+class Denoiser{
+public:
+	// normalPower is rounded up to a power of two
+	Denoiser(int iterations = 5, float sigmaLuminance = 4.f, int normalPower = 128,
+		float sigmaDepth = 1.f);
+
+	std::vector<Spectrum> denoise(const std::vector<Spectrum>& image,
+		const DenoiserFeatures& features) const;
+
+	const int iterations;
+	const float sigmaLuminance, sigmaDepth;
+
+private:
+	// the normal weight max(0, dot)^normalPower takes this many squarings
+	int normalSquarings;
+};
+
+RIGA_NAMESPACE_END
@@ -3,20 +3,197 @@
 #include <core/common.h>
 #include <core/geometry.h>
 #include <core/spectrum.h>
+#include <core/filter.h>
+#include <core/denoiser.h>
+#include <atomic>
 #include <string>
 #include <vector>
 
 RIGA_NAMESPACE_BEGIN
 
+// float supporting a lock free atomic add
+class AtomicFloat{
+public:
+	explicit AtomicFloat(float v = 0.f) : bits(toBits(v)){}
+	operator float() const{
+		return fromBits(bits.load(std::memory_order_relaxed));
+	}
+	AtomicFloat& operator=(float v){
+		bits.store(toBits(v), std::memory_order_relaxed);
+		return *this;
+	}
+	void add(float v){
+		uint32_t oldBits = bits.load(std::memory_order_relaxed), newBits;
+		do{
+			newBits = toBits(fromBits(oldBits) + v);
+		}while(!bits.compare_exchange_weak(oldBits, newBits, std::memory_order_relaxed));
+	}
+
+private:
+	static uint32_t toBits(float f){
+		uint32_t ui;
+		memcpy(&ui, &f, sizeof(float));
+		return ui;
+	}
+	static float fromBits(uint32_t ui){
+		float f;
+		memcpy(&f, &ui, sizeof(uint32_t));
+		return f;
+	}
+
+	std::atomic<uint32_t> bits;
+};
+
+// first hit features of a camera sample, the denoiser is guided by them. a ray that hits
+// nothing has a zero albedo, normal and depth
+struct AOVSample{
+	Spectrum albedo = Spectrum(0.f);
+	Normal3f normal;
+	float depth = 0.f;
+};
+
+// AOV sums of a pixel, along with the moments of the luminance of its samples that tell
+// the denoiser how noisy the pixel is
+struct AOVPixel{
+	void add(const AOVSample& aov, float luminance){
+		sum.albedo += aov.albedo;
+		sum.normal += aov.normal;
+		sum.depth += aov.depth;
+		luminanceSum += luminance;
+		luminanceSquaredSum += luminance * luminance;
+		weightSum += 1.f;
+	}
+	void add(const AOVPixel& pixel){
+		sum.albedo += pixel.sum.albedo;
+		sum.normal += pixel.sum.normal;
+		sum.depth += pixel.sum.depth;
+		luminanceSum += pixel.luminanceSum;
+		luminanceSquaredSum += pixel.luminanceSquaredSum;
+		weightSum += pixel.weightSum;
+	}
+
+	AOVSample sum;
+	float luminanceSum = 0.f, luminanceSquaredSum = 0.f;
+	float weightSum = 0.f;
+};
+
+struct FilmTilePixel{
+	Spectrum contribSum = Spectrum(0.f);
+	float filterWeightSum = 0.f;
+	AOVPixel aov;
+};
+
+// accumulation buffer of one render tile, its pixel bounds extend the sampled pixels by
+// the filter radius. owned by a single thread, so samples are added without synchronization
+class FilmTile{
+public:
+	FilmTile(const Bounds2i& pixelBounds, const Vec2f& filterRadius, 
+		const float* filterTable, int filterTableWidth);
+	// splats L at pFilm (raster space) into every pixel of the filter's support
+	void addSample(const Point2f& pFilm, const Spectrum& L, float sampleWeight = 1.f);
+	// the AOVs are not filtered, they only count in the pixel the sample belongs to
+	void addAOV(const Point2i& pixel, const AOVSample& aov, const Spectrum& L){
+		getPixel(pixel).aov.add(aov, L.toY());
+	}
+	FilmTilePixel& getPixel(const Point2i& p){
+		return pixels[(p.y - pixelBounds.pMin.y) * width + p.x - pixelBounds.pMin.x];
+	}
+	const FilmTilePixel& getPixel(const Point2i& p) const{
+		return pixels[(p.y - pixelBounds.pMin.y) * width + p.x - pixelBounds.pMin.x];
+	}
+
+	const Bounds2i pixelBounds;
+
+private:
+	const int width;
+	const Vec2f filterRadius, invFilterRadius;
+	const float* filterTable;
+	const int filterTableWidth;
+	std::vector<FilmTilePixel> pixels;
+	// table offsets of the pixels a sample reaches
+	std::vector<int> ifx, ify;
+};
+
 class Film{
 public:
-	Film(const Point2i& resolution, const std::string& file_name = "utitiled.ppm")
-	: fullResolution(resolution), fileName(file_name){}
+	// without a filter every sample only counts in its own pixel (box filter of radius 0.5)
+	Film(const Point2i& resolution, const std::string& file_name = "utitiled.ppm", 
+		std::unique_ptr<Filter> filter = nullptr);
+	~Film();
+
+	std::unique_ptr<FilmTile> getFilmTile(const Bounds2i& sampleBounds) const;
+	// adds the tile to the film with atomic adds, tiles of different threads may overlap
+	void mergeFilmTile(const FilmTile& tile);
+	void clear();
+	// filtered radiance of every pixel, row by row
+	std::vector<Spectrum> getImage() const;
+	// raw accumulated sums of pixel i, for checkpoints
+	void getPixelSums(int i, Spectrum* contribSum, float* filterWeightSum) const;
+	void setPixelSums(int i, const Spectrum& contribSum, float filterWeightSum);
+	// zero without a denoiser
+	AOVPixel getPixelAOVs(int i) const;
+	void setPixelAOVs(int i, const AOVPixel& aov);
+
+	// the image is denoised before it is written, the render loop then records the AOVs of
+	// every camera sample. not available with streaming
+	void setDenoiser(std::unique_ptr<Denoiser> denoiser);
+	bool hasAOVs() const { return denoiser != nullptr; }
+	// the averaged AOVs of every pixel, normals normalized, and the variance of their mean
+	// luminance
+	DenoiserFeatures getFeatures() const;
+
+	// writes the image in the format given by the extension of fileName : .pfm and
+	// .exr keep the linear float radiance, anything else is a clamped 8 bit ppm
+	void writeImage() const;
 
-	void write2PPM(const std::vector<Spectrum>& framebuffer);
+	// streaming, for images that do not fit in memory : the film only keeps the rows that
+	// samples can still reach and writes every finished row straight into fileName (a .pfm)
+	// through a memory mapping. rendering has to go in bands of tile rows (the
+	// SamplerIntegrator::TileSize rows the integrators render) from the top, each band
+	// followed by finishRows. checkpoints, getImage and writeImage are not available
+	void setStreaming();
+	bool isStreaming() const { return streamRows > 0; }
+	// no sample will land in a row above y anymore, the rows that can not be reached by
+	// later samples are written out and their memory is released
+	void finishRows(int y);
+
+	void write2PPM(const std::vector<Spectrum>& framebuffer) const;
+	void write2PFM(const std::vector<Spectrum>& framebuffer) const;
+	// uncompressed scanline OpenEXR with 32 bit float R, G, B channels
+	void write2EXR(const std::vector<Spectrum>& framebuffer) const;
 
 	const Point2i fullResolution;
 	const std::string fileName;
+	const std::unique_ptr<Filter> filter;
+	// samples of the filter at the centers of a grid over [0, radius.x] x [0, radius.y]
+	static constexpr int FilterTableWidth = 16;
+
+private:
+	struct Pixel{
+		AtomicFloat rgb[3];
+		AtomicFloat filterWeightSum;
+	};
+
+	// every format is assembled in memory and written with a single fwrite
+	void writeFile(const std::vector<uint8_t>& data) const;
+
+	Pixel& pixelAt(int x, int y){
+		return pixels[(streamRows > 0 ? y % streamRows : y) * fullResolution.x + x];
+	}
+	void closeStream();
+
+	const Vec2f filterRadius;
+	float filterTable[FilterTableWidth * FilterTableWidth];
+	// all the pixels, or a ring of streamRows rows when streaming. allocated by clear
+	std::vector<Pixel> pixels;
+	std::unique_ptr<Denoiser> denoiser;
+	// empty without a denoiser. only the tile that samples a pixel adds to its AOVs, merges
+	// do not race on them
+	std::vector<AOVPixel> aovs;
+
+	int streamRows = 0, rowsFinished = 0;
+	uint8_t* stream = nullptr;
+	size_t streamSize = 0, streamHeaderSize = 0, streamReleased = 0;
 };
 
-RIGA_NAMESPACE_END
\ No newline at end of file
+RIGA_NAMESPACE_END
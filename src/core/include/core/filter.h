@@ -0,0 +1,19 @@
+#pragma once
+
+#include <core/common.h>
+#include <core/geometry.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// reconstruction filter centered at the origin, zero outside of [-radius, radius]
+class Filter{
+public:
+	Filter(const Vec2f& radius)
+	: radius(radius), invRadius(1.f / radius.x, 1.f / radius.y){}
+	virtual ~Filter(){}
+	virtual float evaluate(const Point2f& p) const = 0;
+
+	const Vec2f radius, invRadius;
+};
+
+RIGA_NAMESPACE_END
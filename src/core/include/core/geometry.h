@@ -1255,4 +1255,44 @@ inline bool Refract(const Vec3f& wi, const Normal3f& n, float eta, Vec3f *wt){
 	*wt = -wi * eta + (eta * cosThetaI - cosThetaT) * Vec3f(n);
 	return true;
 }
+
+// the directions within an angle of w, cosTheta = Infinity holds no direction
+struct DirectionCone{
+	DirectionCone(){}
+	DirectionCone(const Vec3f& w, float cosTheta) : w(Normalize(w)), cosTheta(cosTheta){}
+	bool isEmpty() const { return cosTheta == Infinity; }
+	static DirectionCone EntireSphere(){
+		return DirectionCone(Vec3f(0.f, 0.f, 1.f), -1.f);
+	}
+
+	Vec3f w;
+	float cosTheta = Infinity;
+};
+
+// the smallest cone holding both
+inline DirectionCone Union(const DirectionCone& a, const DirectionCone& b){
+	if(a.isEmpty())
+		return b;
+	if(b.isEmpty())
+		return a;
+	const float thetaA = std::acos(Clamp(a.cosTheta, -1.f, 1.f));
+	const float thetaB = std::acos(Clamp(b.cosTheta, -1.f, 1.f));
+	const float thetaD = std::acos(Clamp(Dot(a.w, b.w), -1.f, 1.f));
+	if(std::min(thetaD + thetaB, PI) <= thetaA)
+		return a;
+	if(std::min(thetaD + thetaA, PI) <= thetaB)
+		return b;
+
+	// the cone spans from the far side of a to the far side of b, its axis is a.w turned
+	// towards b.w
+	const float thetaO = (thetaA + thetaD + thetaB) / 2;
+	if(thetaO >= PI)
+		return DirectionCone::EntireSphere();
+	const Vec3f axis = Cross(a.w, b.w);
+	if(axis.lengthSquared() == 0.f)
+		return DirectionCone::EntireSphere();
+	const float thetaR = thetaO - thetaA;
+	const Vec3f w = a.w * std::cos(thetaR) + Cross(Normalize(axis), a.w) * std::sin(thetaR);
+	return DirectionCone(w, std::cos(thetaO));
+}
 RIGA_NAMESPACE_END
\ No newline at end of file
@@ -3,8 +3,29 @@
 #include <core/common.h>
 #include <core/sampler.h>
 #include <core/camera.h>
+#include <core/lightdistrib.h>
+#include <atomic>
+#include <shared_mutex>
 RIGA_NAMESPACE_BEGIN
 
+// running mean and variance (Welford) of the luminance of a pixel's samples
+struct PixelStats{
+	void add(const Spectrum& L){
+		const float y = L.toY(), delta = y - mean;
+		mean += delta / ++n;
+		m2 += delta * (y - mean);
+	}
+	// standard error of the mean relative to the mean
+	float error() const{
+		if(n < 2)
+			return Infinity;
+		return std::sqrt(m2 / ((n - 1) * n)) / std::max(mean, 0.01f);
+	}
+
+	float mean = 0.f, m2 = 0.f;
+	int64_t n = 0;
+};
+
 class Integrator{
 public:
 	virtual ~Integrator(){}
@@ -17,15 +38,69 @@ public:
 	: camera(cam), sampler(samp){}
 	
 	Spectrum specularReflect(const Ray& ray, const SurfaceInteraction& isec, 
-		const Scene& scene, Sampler& sampler, int depth) const;
+		const Scene& scene, Sampler& sampler, MemoryArena& arena, int depth) const;
 	Spectrum specularTransmit(const Ray& ray, const SurfaceInteraction& isec, 
-		const Scene& scene, Sampler& sampler, int depth) const;
+		const Scene& scene, Sampler& sampler, MemoryArena& arena, int depth) const;
 
-	virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler, int depth = 0) const = 0;
+	// per sample allocations go to arena, which is reset after every camera sample
+	virtual Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler, 
+		MemoryArena& arena, int depth = 0) const = 0;
 	void render(const Scene& scene);
 
+	// adaptive sampling : every pixel of a tile gets minSamples samples, then the pixels whose
+	// standard error of the mean luminance (relative to max(mean, 0.01)) is above maxError 
+	// double their count, round after round, until the tile has spent spp samples per pixel.
+	// a pixel takes at most maxSampleFactor * spp. maxError <= 0 turns it off
+	void setAdaptiveSampling(float maxError, int minSamples = 8, float maxSampleFactor = 4.f);
+	// progressive rendering : the image is refined in passes of 1, 2, 4 ... spp, the film is
+	// written after every pass. stops once timeBudget seconds have passed, the mean relative
+	// error of the pixels is below maxError or a pass reaches maxSpp. 0 disables a criterion,
+	// timeBudget and maxError both 0 turn the mode off. maxSpp 0 is maxSampleFactor (see
+	// setAdaptiveSampling) times the spp of the sampler
+	void setProgressive(float timeBudget, float maxError = 0.f, int64_t maxSpp = 0);
+	// checkpoints : the film sums and the statistics of every pixel are saved to fileName
+	// every interval seconds and when the render ends. a render that finds a checkpoint of
+	// the same resolution resumes from it, every pixel continues at its next sample number.
+	// interval 0 only saves at the end
+	void setCheckpoint(const std::string& fileName, float interval = 600.f);
+	// direct lighting takes one light per shading point from the light distribution of this
+	// name (see CreateLightDistribution) instead of every light. empty samples them all
+	void setLightDistribution(const std::string& name);
+
+	// edge length (in pixels) of the square tiles handed out to render threads
+	static constexpr int TileSize = 16;
+	// specular bounces firstHit follows at most
+	static constexpr int MaxAOVSpecularBounces = 4;
+
 protected:
+	void renderProgressive(const Scene& scene, std::vector<PixelStats>& stats);
+	// samples every pixel of tileBounds up to spp samples (adaptive : spp on average) into the
+	// film, stats holds the statistics of all the pixels of the image or nothing (streaming).
+	// returns the number of samples the pixels of the tile hold
+	int64_t renderTile(const Scene& scene, const Bounds2i& tileBounds, Sampler& tileSampler, 
+		MemoryArena& arena, std::vector<PixelStats>& stats, int64_t spp, bool adaptive) const;
+	// albedo, shading normal and distance of the first surface the camera ray hits. perfectly
+	// specular surfaces are looked through, the albedo then carries their reflectance
+	AOVSample firstHit(const Ray& ray, const Scene& scene, MemoryArena& arena) const;
+	void writeCheckpoint(const std::vector<PixelStats>& stats) const;
+	bool loadCheckpoint(std::vector<PixelStats>& stats) const;
+
 	std::shared_ptr<const Camera> camera;
+	float adaptiveMaxError = 0.f;
+	int adaptiveMinSamples = 8;
+	float adaptiveMaxSampleFactor = 4.f;
+	float progressiveTimeBudget = 0.f, progressiveMaxError = 0.f;
+	int64_t progressiveMaxSpp = 0;
+	std::string lightDistributionName;
+	// built by render for the scene, nullptr when every light is sampled
+	std::unique_ptr<LightDistribution> lightDistribution;
+	std::string checkpointFile;
+	float checkpointInterval = 0.f;
+	// tile merges share it, a checkpoint takes it exclusively to copy a consistent state
+	mutable std::shared_mutex checkpointMutex;
+	mutable std::atomic<bool> checkpointWriting{false};
+	// steady clock ticks
+	mutable std::atomic<int64_t> lastCheckpoint{0};
 private:
 	std::shared_ptr<Sampler> sampler;
 
@@ -40,7 +40,8 @@ public:
 	SurfaceInteraction(){}
 	SurfaceInteraction(const Point3f& p, const Normal3f& n, const Vec3f& wo, float t, 
 		const Point2f& UV, const Shape* sh);
-	void computeScatteringFunctions(const Ray& ray, TransportMode mode = TransportMode::Radiance);
+	void computeScatteringFunctions(const Ray& ray, MemoryArena& arena, 
+		TransportMode mode = TransportMode::Radiance);
 	void setShadingInfo(const Normal3f& shadingNormal);
 	Spectrum Le(const Vec3f& w) const;
 	
@@ -50,7 +51,8 @@ public:
 	struct{
 		Normal3f n;
 	}shading;
-	std::unique_ptr<BSDF> bsdf;
+	// lives in the MemoryArena passed to computeScatteringFunctions
+	BSDF* bsdf = nullptr;
 };
 
 RIGA_NAMESPACE_END
\ No newline at end of file
@@ -11,6 +11,30 @@ enum class LightFlags : int {
 	Infinite = 8
 }; 
 
+// where a light emits and how much, for the light BVH : power phi leaves the points of bounds
+// into the directions within an angle thetaO of w (on both sides of the surface when twoSided),
+// falling off to nothing at thetaO + thetaE
+struct LightBounds{
+	LightBounds(){}
+	LightBounds(const Bounds3f& bounds, const Vec3f& w, float phi, float cosThetaO, float cosThetaE,
+		bool twoSided) : bounds(bounds), w(Normalize(w)), phi(phi), cosThetaO(cosThetaO), 
+		cosThetaE(cosThetaE), twoSided(twoSided){}
+	// a conservative estimate of what the lights reach at p on a surface with normal n, 
+	// a zero normal is ignored
+	float importance(const Point3f& p, const Normal3f& n) const;
+	Point3f centroid() const{
+		return (bounds.pMin + bounds.pMax) * 0.5f;
+	}
+
+	Bounds3f bounds;
+	Vec3f w;
+	float phi = 0.f;
+	float cosThetaO = 1.f, cosThetaE = 1.f;
+	bool twoSided = false;
+};
+
+LightBounds Union(const LightBounds& a, const LightBounds& b);
+
 class Light{
 public:
 	virtual ~Light(){}
@@ -18,6 +42,9 @@ public:
 	virtual Spectrum sample_Li(const Interaction& ref, const Point2f& sample, 
 							  Vec3f* wi, float *pdf, VisibilityTester* vis) const = 0;
 	virtual float pdf_Li(const Interaction& ref, const Vec3f& wi) const = 0;
+	// total power the light emits
+	virtual Spectrum power() const = 0;
+	virtual LightBounds bounds() const = 0;
 
 	LightFlags flags;
 	const int nSamples;
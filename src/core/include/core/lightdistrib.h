@@ -0,0 +1,102 @@
+#pragma once
+
+#include <core/common.h>
+#include <core/geometry.h>
+#include <core/light.h>
+#include <core/sampling.h>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+
+RIGA_NAMESPACE_BEGIN
+
+// picks the light a direct lighting sample is taken from, in proportion to an estimate of
+// what the light contributes at the shading point
+class LightDistribution{
+public:
+	virtual ~LightDistribution(){}
+	// a light for ref, chosen with probability *pmf, or nullptr when no light reaches ref
+	virtual const Light* sample(const Interaction& ref, float u, float* pmf) const = 0;
+	// the probability that sample picks light for ref
+	virtual float pmf(const Interaction& ref, const Light* light) const = 0;
+};
+
+// by name : "power", "spatial", "bvh". nullptr for an empty name, which leaves the integrators sampling every light
+std::unique_ptr<LightDistribution> CreateLightDistribution(const std::string& name, const Scene& scene);
+
+// lights in proportion to their power, wherever the shading point is. picking a light is a
+// lookup in an alias table
+class PowerLightDistribution : public LightDistribution{
+public:
+	PowerLightDistribution(const std::vector<std::shared_ptr<Light>>& lights);
+	const Light* sample(const Interaction& ref, float u, float* pmf) const;
+	float pmf(const Interaction& ref, const Light* light) const;
+
+private:
+	std::vector<std::shared_ptr<Light>> lights;
+	AliasTable aliasTable;
+	std::unordered_map<const Light*, int> lightToIndex;
+};
+
+// a light distribution per voxel of a grid over the scene bounds (pbrt-v3), made the first
+// time a shading point falls in the voxel from the light arriving at points spread over it.
+// lights that reach no point of the voxel keep a small probability so that none is left out.
+// the distributions are kept in a hash table of fixed size that threads fill without locks
+class SpatialLightDistribution : public LightDistribution{
+public:
+	// maxVoxels along the longest axis of the scene bounds
+	SpatialLightDistribution(const Scene& scene, int maxVoxels = 64);
+	~SpatialLightDistribution();
+	const Light* sample(const Interaction& ref, float u, float* pmf) const;
+	float pmf(const Interaction& ref, const Light* light) const;
+
+private:
+	// the distribution of the voxel ref lies in, made on first use
+	const AliasTable& lookup(const Point3f& p) const;
+	AliasTable* computeDistribution(int voxel[3]) const;
+
+	const Scene& scene;
+	std::vector<std::shared_ptr<Light>> lights;
+	std::unordered_map<const Light*, int> lightToIndex;
+	int nVoxels[3];
+	// the voxel coordinates packed in packedPos, empty entries hold invalidPackedPos.
+	// a thread that claims an entry fills distribution, the others wait for it
+	struct HashEntry{
+		std::atomic<uint64_t> packedPos;
+		std::atomic<AliasTable*> distribution;
+	};
+	static constexpr uint64_t invalidPackedPos = 0xffffffffffffffff;
+	mutable std::unique_ptr<HashEntry[]> hashTable;
+	size_t hashTableSize;
+};
+
+// light BVH (Conty Estevez and Kulla, as in pbrt-v4) : the lights are the leaves of a binary
+// tree whose nodes hold the bounds, the summed power and the emission cone of their lights.
+// sampling walks down from the root and takes each child in proportion to its importance at
+// the shading point, picking a light takes time logarithmic in the number of lights
+class BVHLightDistribution : public LightDistribution{
+public:
+	BVHLightDistribution(const std::vector<std::shared_ptr<Light>>& lights);
+	const Light* sample(const Interaction& ref, float u, float* pmf) const;
+	float pmf(const Interaction& ref, const Light* light) const;
+
+private:
+	// the first child of an interior node follows it, index is the second child. a leaf
+	// holds the light index
+	struct Node{
+		LightBounds bounds;
+		int index;
+		bool isLeaf;
+	};
+	// the light bounds of [start, end) are reordered, returns the index of the node
+	int build(std::vector<std::pair<int, LightBounds>>& bvhLights, int start, int end,
+		uint64_t bitTrail, int depth);
+
+	std::vector<std::shared_ptr<Light>> lights;
+	std::vector<Node> nodes;
+	// the path from the root to the leaf of a light, bit i is set when it takes the second
+	// child at depth i. lights without power are not in the tree
+	std::unordered_map<const Light*, uint64_t> bitTrails;
+};
+
+RIGA_NAMESPACE_END
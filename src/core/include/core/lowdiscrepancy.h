@@ -5,14 +5,21 @@
 
 RIGA_NAMESPACE_BEGIN
 static constexpr int PrimeTableSize = 1000;
+static constexpr int NumSobolDimensions = 1024;
+static constexpr int SobolMatrixSize = 32;
 
 // Low Discrepancy Declarations
 float RadicalInverse(int baseIndex, uint64_t a);
+// batch version, fills result[i] with RadicalInverse(baseIndex, a[i])
+void RadicalInverse(int baseIndex, const uint64_t *a, int n, float *result);
 std::vector<uint16_t> ComputeRadicalInversePermutations(pcg32 &rng);
 extern const int Primes[PrimeTableSize];
 float ScrambledRadicalInverse(int baseIndex, uint64_t a, const uint16_t *perm);
 extern const int PrimeSums[PrimeTableSize];
 extern uint32_t CMaxMinDist[17][32];
+// generator matrices of the first NumSobolDimensions Sobol dimensions, SobolMatrixSize 
+// columns each. built on first use
+const uint32_t *SobolMatrices32();
 
 // Low Discrepancy Inline Functions
 inline uint32_t ReverseBits32(uint32_t n) {
@@ -41,6 +48,59 @@ inline uint64_t InverseRadicalInverse(uint64_t inverse, int nDigits) {
     return index;
 }
 
+// Radical inverse in a small base that converts several digits per step with a lookup
+// table, a digit permutation can be folded into the table. one step handles as many
+// digits as fit in MaxTableSize entries : 10 for base 2, 6 for base 3, 4 for 5, 3 for 7
+template <int base>
+class RadicalInverseTable {
+  public:
+    static constexpr uint32_t MaxTableSize = 1024;
+    static constexpr uint32_t stepBase() {
+        uint32_t b = 1;
+        while (b * base <= MaxTableSize) b *= base;
+        return b;
+    }
+    static constexpr uint32_t StepBase = stepBase();
+
+    explicit RadicalInverseTable(const uint16_t *perm = nullptr) {
+        for (uint32_t chunk = 0; chunk < StepBase; ++chunk) {
+            uint32_t v = chunk, reversed = 0;
+            for (uint32_t b = 1; b < StepBase; b *= base) {
+                uint32_t digit = v % base;
+                v /= base;
+                reversed = reversed * base + (perm ? perm[digit] : digit);
+            }
+            table[chunk] = reversed;
+        }
+        // a permuted zero digit is not zero, it adds the infinite tail of perm[0] digits
+        const float invBase = (float)1 / (float)base;
+        tail = perm ? invBase * perm[0] / (1 - invBase) : 0.f;
+    }
+
+    float operator()(uint64_t a) const {
+        const float invStepBase = (float)1 / (float)StepBase;
+        uint64_t reversedDigits = 0;
+        float invBaseN = 1;
+        while (a) {
+            uint64_t next = a / StepBase;
+            uint64_t chunk = a - next * StepBase;
+            reversedDigits = reversedDigits * StepBase + table[chunk];
+            invBaseN *= invStepBase;
+            a = next;
+        }
+        return std::min(invBaseN * (reversedDigits + tail), OneMinusEpsilon);
+    }
+
+    // fills result[i] with the radical inverse of a[i]
+    void evaluate(const uint64_t *a, int n, float *result) const {
+        for (int i = 0; i < n; ++i) result[i] = (*this)(a[i]);
+    }
+
+  private:
+    uint16_t table[StepBase];
+    float tail;
+};
+
 inline uint32_t MultiplyGenerator(const uint32_t *C, uint32_t a) {
     uint32_t v = 0;
     for (int i = 0; a != 0; ++i, a >>= 1)
@@ -56,6 +116,41 @@ inline float SampleGeneratorMatrix(const uint32_t *C, uint32_t a,
 
 inline uint32_t GrayCode(uint32_t v) { return (v >> 1) ^ v; }
 
+inline uint64_t MixBits(uint64_t v) {
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44d;
+    v ^= (v >> 33);
+    return v;
+}
+
+// Laine-Karras style hash that permutes the bits of v like a nested uniform (Owen)
+// scramble : every bit is flipped depending only on the bits above it
+inline uint32_t FastOwenScramble(uint32_t v, uint32_t seed) {
+    v = ReverseBits32(v);
+    v ^= v * 0x3d20adea;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56;
+    v ^= v * 0x53a22864;
+    return ReverseBits32(v);
+}
+
+enum class RandomizeStrategy { None, XOR, Owen };
+
+// sample a of the Sobol sequence in the given dimension, randomized with seed
+inline float SobolSample(uint32_t a, int dimension, RandomizeStrategy randomize,
+                         uint32_t seed = 0) {
+    uint32_t v = MultiplyGenerator(SobolMatrices32() + dimension * SobolMatrixSize, a);
+    if (randomize == RandomizeStrategy::XOR)
+        v ^= seed;
+    else if (randomize == RandomizeStrategy::Owen)
+        v = FastOwenScramble(v, seed);
+    // keep 24 bits, rounding v * 2^-32 to float could push a point into the next stratum
+    return (v >> 8) * float(0x1p-24);
+}
+
 inline void GrayCodeSample(const uint32_t *C, uint32_t n, uint32_t scramble,
                            float *p) {
     uint32_t v = scramble;
@@ -100,5 +195,19 @@ inline void VanDerCorput(int nSamplesPerPixelSample, int nPixelSamples,
     Shuffle(samples, nPixelSamples, nSamplesPerPixelSample, rng);
 }
 
+inline void Sobol2D(int nSamplesPerPixelSample, int nPixelSamples,
+                    Point2f *samples, pcg32 &rng) {
+    Point2i scramble;
+    scramble[0] = rng.nextUInt();
+    scramble[1] = rng.nextUInt();
+    // the first two Sobol dimensions form a (0,2)-sequence
+    const uint32_t *C = SobolMatrices32();
+    GrayCodeSample(C, C + SobolMatrixSize, nSamplesPerPixelSample * nPixelSamples,
+                   scramble, samples);
+    for (int i = 0; i < nPixelSamples; ++i)
+        Shuffle(samples + i * nSamplesPerPixelSample, nSamplesPerPixelSample, 1,
+                rng);
+    Shuffle(samples, nPixelSamples, nSamplesPerPixelSample, rng);
+}
 
 RIGA_NAMESPACE_END
\ No newline at end of file
@@ -11,8 +11,11 @@ enum class TransportMode{
 
 class Material{
 public:
+	// the BSDF and its BxDFs are allocated from arena
 	virtual void computeScatteringFunctions(
-		SurfaceInteraction* isect, TransportMode mode) const = 0;
+		SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const = 0;
+	// reflectance of the surface at isect, the denoiser takes it as the albedo AOV
+	virtual Spectrum albedo(const SurfaceInteraction& isect) const = 0;
 	virtual ~Material(){};
 };
 
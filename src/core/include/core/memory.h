@@ -0,0 +1,43 @@
+#pragma once
+
+#include <core/common.h>
+#include <list>
+#include <utility>
+
+RIGA_NAMESPACE_BEGIN
+
+// placement new of a Type in arena, objects are never destructed
+#define ARENA_ALLOC(arena, Type) new ((arena).alloc(sizeof(Type))) Type
+
+// bump pointer allocator for short lived objects (BSDFs, BxDFs), memory is handed
+// back all at once by reset(). not thread safe, every render thread owns its own
+class alignas(64) MemoryArena{
+public:
+	MemoryArena(size_t blockSize = 262144) : blockSize(blockSize){}
+	~MemoryArena();
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+	void* alloc(size_t nBytes);
+	template <typename T>
+	T* alloc(size_t n = 1, bool runConstructor = true){
+		T* ret = (T*)alloc(n * sizeof(T));
+		if(runConstructor)
+			for(size_t i=0; i<n; ++i)
+				new (&ret[i]) T();
+		return ret;
+	}
+	// keeps the blocks for reuse
+	void reset();
+	size_t totalAllocated() const;
+
+private:
+	static constexpr size_t Align = 16;
+
+	const size_t blockSize;
+	size_t currentBlockPos = 0, currentAllocSize = 0;
+	uint8_t* currentBlock = nullptr;
+	std::list<std::pair<size_t, uint8_t*>> usedBlocks, availableBlocks;
+};
+
+RIGA_NAMESPACE_END
@@ -15,7 +15,7 @@ public:
 	virtual bool intersect(const Ray& ray, SurfaceInteraction *) const = 0;
 	virtual bool intersectP(const Ray& ray) const = 0;
 	virtual void computeScatteringFunctions(
-		SurfaceInteraction* isect, TransportMode mode) const = 0;
+		SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const = 0;
 	virtual	AreaLight* getAreaLight() const = 0;
 	virtual Material* getMaterial() const = 0;
 };
@@ -31,8 +31,11 @@ public:
 	bool intersectP(const Ray& ray) const;
 	AreaLight* getAreaLight() const;
 	Material* getMaterial() const;
+	const Shape* getShape() const{
+		return shape.get();
+	}
 	void computeScatteringFunctions(
-		SurfaceInteraction* isect, TransportMode mode) const;
+		SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const;
 
 private:
 	std::shared_ptr<Shape> shape;
@@ -47,6 +50,11 @@ public:
 	virtual Bounds3f worldBound() const = 0;
 	virtual bool intersect(const Ray& ray, SurfaceInteraction *) const = 0;
 	virtual bool intersectP(const Ray& ray) const = 0;
+	// shadow ray query that also reports the primitive blocking ray, if the aggregate knows it
+	virtual bool intersectP(const Ray& ray, const Primitive** occluder) const{
+		*occluder = nullptr;
+		return intersectP(ray);
+	}
 
 protected:
 	std::vector<std::shared_ptr<Primitive>> primitives;
@@ -20,6 +20,8 @@ float FrDielectric(float cosThetaI, float etaI, float etaT);
 
 Spectrum FrConductor(float cosThetaI, const Spectrum& etaI, const Spectrum& etaT, const Spectrum& k);
 
+// BSDFs, BxDFs and Fresnels are allocated from a MemoryArena and never destructed,
+// so they must not own other resources
 class BSDF{
 public:
 	BSDF(const SurfaceInteraction& isec, float eta = 1.f); 
@@ -41,13 +43,12 @@ public:
 	Spectrum f(const Vec3f& wo_world, const Vec3f& wi_world, 
 		BxDFType flags = BSDF_ALL) const;
 
+	// the flags of the sampled BxDF go to sampledType
 	Spectrum sample_f(const Vec3f& wo_world, Vec3f* wi_world, const Point2f& u, 
-		float *pdf, BxDFType type = BSDF_ALL) const;
+		float *pdf, BxDFType type = BSDF_ALL, BxDFType* sampledType = nullptr) const;
 	
 	float pdf(const Vec3f& wo_world, const Vec3f& wi_world, BxDFType flags = BSDF_ALL) const;
 
-	~BSDF();
-
 	// friend std::ostream& operator<<(std::ostream& os, const BSDF& bsdf){
 	// 	os << "[ BSDF eta: " << eta << " ,nBxDFs: " << nBxDFs;
 	// 	for(size_t i=0; i<nBxDFs; ++i)
@@ -124,8 +125,8 @@ public:
 
 class SpecularReflection : public BxDF{
 public:
-	SpecularReflection(const Spectrum& R, std::unique_ptr<Fresnel> fres)
-		: BxDF(BxDFType(BSDF_REFLECTION | BSDF_SPECULAR)), R(R), fresnel(std::move(fres)){}
+	SpecularReflection(const Spectrum& R, const Fresnel* fres)
+		: BxDF(BxDFType(BSDF_REFLECTION | BSDF_SPECULAR)), R(R), fresnel(fres){}
 	Spectrum f(const Vec3f& wo, const Vec3f& wi) const{
 		return Spectrum(0.f);
 	}
@@ -135,7 +136,7 @@ public:
 	}
 private:
 	const Spectrum R;
-	const std::unique_ptr<Fresnel> fresnel;
+	const Fresnel* fresnel;
 };
 
 class SpecularTransmission : public BxDF{
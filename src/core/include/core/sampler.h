@@ -2,6 +2,7 @@
 
 #include <core/common.h>
 #include <core/geometry.h>
+#include <pcg32/pcg32.h>
 
 RIGA_NAMESPACE_BEGIN
 
@@ -20,8 +21,14 @@ class Sampler{
     const float *get1DArray(int n);
     const Point2f *get2DArray(int n);
     virtual bool startNextSample();
+    // the integrator clones once per render thread and moves the clone from pixel to
+    // pixel with startPixel, so samples must only depend on the pixel and sample number
     virtual std::unique_ptr<Sampler> clone(int seed) = 0;
     virtual bool setSampleNumber(int64_t sampleNum);
+    // all pixels share one sequence which every pixel scrambles with a blue noise tile,
+    // the error of low spp renders is then spread as blue noise over the image instead
+    // of white noise. clones keep the setting
+    void setBlueNoise(bool enable) { blueNoise = enable; }
     
     int64_t currentSampleNumber() const { return currentPixelSampleIndex; }
 
@@ -40,10 +47,48 @@ class Sampler{
     std::vector<int> samples1DArraySizes, samples2DArraySizes;
     std::vector<std::vector<float>> sampleArray1D;
     std::vector<std::vector<Point2f>> sampleArray2D;
+    bool blueNoise = false;
+
+    // scrambles the next value of the current sample, each value reads the tile at its 
+    // own offset so the dimensions are decorrelated
+    float blueNoiseScramble(float u);
 
   private:
     // Sampler Private Data
     size_t array1DOffset, array2DOffset;
+    int blueNoiseDimension = 0;
+};
+
+class PixelSampler : public Sampler {
+  public:
+    // PixelSampler Public Methods
+    PixelSampler(int64_t samplesPerPixel, int nSampledDimensions, int seed = 0);
+    void startPixel(const Point2i &p);
+    bool startNextSample();
+    bool setSampleNumber(int64_t);
+    float get1D();
+    Point2f get2D();
+
+  protected:
+    // PixelSampler Protected Data
+    // per pixel tables, subclasses fill them in startPixel after calling
+    // PixelSampler::startPixel, which seeds rng from the pixel
+    std::vector<std::vector<float>> samples1D;
+    std::vector<std::vector<Point2f>> samples2D;
+    int current1DDimension = 0, current2DDimension = 0;
+    pcg32 rng;
+
+  private:
+    // PixelSampler Private Methods
+    uint64_t pixelHash() const;
+    // dimensions past the tables and samples past samplesPerPixel are uniform random, 
+    // rng is reseeded from the pixel and the sample number on their first use so that
+    // a pixel revisited by adaptive or progressive rendering gets the same values
+    float nextRandom();
+
+    // PixelSampler Private Data
+    const int seed;
+    bool sampleSeeded = false;
 };
 
 class GlobalSampler : public Sampler {
@@ -1,9 +1,39 @@
 #pragma once
 #include <core/geometry.h>
 #include <pcg32/pcg32.h>
+#include <vector>
 
 RIGA_NAMESPACE_BEGIN
 
+// Sampling Declarations
+void StratifiedSample1D(float *samp, int nSamples, pcg32 &rng, bool jitter = true);
+void StratifiedSample2D(Point2f *samp, int nx, int ny, pcg32 &rng, bool jitter = true);
+void LatinHypercube(float *samples, int nSamples, int nDim, pcg32 &rng);
+// BlueNoiseTileSize x BlueNoiseTileSize tileable blue noise, values in (0, 1) stored
+// row by row. made by void and cluster on first use
+static constexpr int BlueNoiseTileSize = 64;
+const float *BlueNoiseTile();
+
+// Walker's alias method : an index drawn in proportion to weights in constant time. each
+// bin keeps its own index with probability q and otherwise gives its alias
+class AliasTable {
+  public:
+    AliasTable() = default;
+    AliasTable(const std::vector<float> &weights);
+
+    // -1 when every weight is zero. u is stretched back to [0, 1) in *uRemapped
+    int sample(float u, float *pmf = nullptr, float *uRemapped = nullptr) const;
+    float pmf(int index) const { return bins[index].p; }
+    int size() const { return bins.size(); }
+
+  private:
+    struct Bin {
+        float q, p;
+        int alias;
+    };
+    std::vector<Bin> bins;
+};
+
 // Sampling Inline Functions
 template <typename T>
 void Shuffle(T *samp, int count, int nDimensions, pcg32 &rng) {
@@ -26,5 +56,10 @@ Point2f UniformSampleTriangle(const Point2f& sample){
     return Point2f(1.f - tmp, sample.y * tmp);
 }
 
+// multiple importance sampling weight of a sample from f, nf samples taken from f and ng from g
+inline float PowerHeuristic(int nf, float fPdf, int ng, float gPdf) {
+    float f = nf * fPdf, g = ng * gPdf;
+    return (f * f) / (f * f + g * g);
+}
 
 RIGA_NAMESPACE_END
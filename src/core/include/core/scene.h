@@ -3,12 +3,13 @@
 #include <core/common.h>
 #include <core/primitive.h>
 #include <core/geometry.h>
+#include <atomic>
 
 RIGA_NAMESPACE_BEGIN
 class Scene{
 public:
 	Scene(std::unique_ptr<Aggregate> aggregate, const std::vector<std::shared_ptr<Light>>& lights)
-		: lights(lights), agg(std::move(aggregate)){
+		: lights(lights), agg(std::move(aggregate)), id(nextId++){
 			sceneBound = agg->worldBound();
 		}
 	const Bounds3f& worldBound() const{
@@ -22,6 +23,9 @@ public:
 private:
 	Bounds3f sceneBound;
 	std::unique_ptr<Aggregate> agg;
+	// identifies the scene owning a thread's cached occluder
+	const uint64_t id;
+	static std::atomic<uint64_t> nextId;
 };
 
 RIGA_NAMESPACE_END
\ No newline at end of file
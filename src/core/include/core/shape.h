@@ -18,6 +18,10 @@ public:
 		return 	intersect(ray, nullptr, nullptr);
 	}
 	virtual float area() const = 0;
+	// the normals of the surface, as sample returns them
+	virtual DirectionCone normalBounds() const{
+		return DirectionCone::EntireSphere();
+	}
 
 	virtual Interaction sample(const Point2f& u, float *pdf) const = 0;
 	virtual float pdf(const Interaction& ) const{
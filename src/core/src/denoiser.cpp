@@ -0,0 +1,211 @@
+#include <core/denoiser.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include <algorithm>
+
+RIGA_NAMESPACE_BEGIN
+
+static constexpr float B3Spline[5] = {1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4, 1.f / 16};
+
+// exp(x) for x <= 0 within 2e-4 relative error, branch free so that the weight loops
+// vectorize (std::exp does not without -ffast-math). 2^x is split into 2^integer, built in
+// the exponent bits, and a polynomial for 2^fraction with the fraction in (-1, 0]
+static inline float ExpNegative(float x){
+	// max(x * log2(e), -125) without a compare, which would keep the loop from vectorizing
+	const float s = x * 1.44269504f + 125.f, t = 0.5f * (s + std::abs(s)) - 125.f;
+	const int i = (int)t;
+	const float f = t - i;
+	const float p = 1.f + f * (0.693147f + f * (0.240227f + f * (0.0555041f + 
+		f * (0.00961813f + f * 0.00133336f))));
+	const int32_t bits = (i + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(float));
+	return p * scale;
+}
+
+DenoiserFeatures::DenoiserFeatures(int width, int height)
+	: width(width), height(height), depth(width * height), variance(width * height, -1.f){
+	for(int c=0; c<3; ++c){
+		albedo[c].resize(width * height);
+		normal[c].resize(width * height);
+	}
+}
+
+Denoiser::Denoiser(int iterations, float sigmaLuminance, int normalPower, float sigmaDepth)
+	: iterations(std::max(1, iterations)), sigmaLuminance(sigmaLuminance),
+	  sigmaDepth(sigmaDepth), normalSquarings(0){
+	while((1 << normalSquarings) < normalPower)
+		++normalSquarings;
+}
+
+std::vector<Spectrum> Denoiser::denoise(const std::vector<Spectrum>& image,
+	const DenoiserFeatures& features) const{
+	const int width = features.width, height = features.height, nPixels = width * height;
+	if((int)image.size() != nPixels)
+		throw("The denoiser features do not match the image!");
+	auto parallelRows = [&](const auto& rowFunc){
+		tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r){
+			for(int y=r.begin(); y<r.end(); ++y)
+				rowFunc(y);
+		});
+	};
+
+	// demodulated irradiance, black albedos are left alone
+	std::vector<float> color[3], filtered[3], albedo[3];
+	for(int c=0; c<3; ++c){
+		color[c].resize(nPixels);
+		filtered[c].resize(nPixels);
+		albedo[c].resize(nPixels);
+	}
+	std::vector<float> luminance(nPixels), variance(nPixels), filteredVariance(nPixels);
+	std::vector<float> invSigmaLuminance(nPixels), depthGradient(nPixels);
+	parallelRows([&](int y){
+		for(int i=y*width; i<(y+1)*width; ++i)
+			for(int c=0; c<3; ++c){
+				const float a = features.albedo[c][i];
+				albedo[c][i] = a > 1e-3f ? a : 1.f;
+				color[c][i] = image[i][c] / albedo[c][i];
+			}
+	});
+	auto computeLuminance = [&](){
+		parallelRows([&](int y){
+			for(int i=y*width; i<(y+1)*width; ++i)
+				luminance[i] = 0.212671f * color[0][i] + 0.715160f * color[1][i] + 0.072169f * color[2][i];
+		});
+	};
+	computeLuminance();
+
+	// the variance of the irradiance is the one of the samples divided by the squared albedo
+	// luminance. where it is unknown the spatial one of the 3x3 neighbourhood stands in, as
+	// SVGF does for pixels without a history. the depth gradient comes from central differences
+	const std::vector<float>& depth = features.depth;
+	parallelRows([&](int y){
+		const int y0 = std::max(0, y - 1), y1 = std::min(height - 1, y + 1);
+		for(int x=0; x<width; ++x){
+			const int x0 = std::max(0, x - 1), x1 = std::min(width - 1, x + 1);
+			const int i = y * width + x;
+			if(features.variance[i] >= 0.f){
+				const float a = 0.212671f * albedo[0][i] + 0.715160f * albedo[1][i] + 0.072169f * albedo[2][i];
+				variance[i] = features.variance[i] / (a * a);
+			}else{
+				float sum = 0.f, sum2 = 0.f;
+				for(int yy=y0; yy<=y1; ++yy)
+					for(int xx=x0; xx<=x1; ++xx){
+						const float l = luminance[yy * width + xx];
+						sum += l;
+						sum2 += l * l;
+					}
+				const float n = (y1 - y0 + 1) * (x1 - x0 + 1), mean = sum / n;
+				variance[i] = std::max(0.f, sum2 / n - mean * mean);
+			}
+			const float gx = (depth[y * width + x1] - depth[y * width + x0]) / std::max(1, x1 - x0);
+			const float gy = (depth[y1 * width + x] - depth[y0 * width + x]) / std::max(1, y1 - y0);
+			depthGradient[y * width + x] = std::max(std::abs(gx), std::abs(gy));
+		}
+	});
+
+	const float* n0 = features.normal[0].data();
+	const float* n1 = features.normal[1].data();
+	const float* n2 = features.normal[2].data();
+	for(int iteration=0; iteration<iterations; ++iteration){
+		const int step = 1 << iteration;
+		// the luminance weight takes the variance blurred by a 3x3 gaussian, which steadies it,
+		// but never more than the pixel's own, which keeps the blur from opening up an edge
+		parallelRows([&](int y){
+			for(int x=0; x<width; ++x){
+				float sum = 0.f, weightSum = 0.f;
+				for(int dy=-1; dy<=1; ++dy)
+					for(int dx=-1; dx<=1; ++dx){
+						const int xx = x + dx, yy = y + dy;
+						if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+							continue;
+						const float w = (dx == 0 ? 2.f : 1.f) * (dy == 0 ? 2.f : 1.f);
+						sum += w * variance[yy * width + xx];
+						weightSum += w;
+					}
+				invSigmaLuminance[y * width + x] = 1.f / (sigmaLuminance * std::sqrt(std::min(sum / weightSum, variance[y * width + x])) + 1e-4f);
+			}
+		});
+		tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r){
+			// row buffers, every tap is a pass over contiguous floats without branches
+			std::vector<float> buffer(8 * width);
+			float* sum[3] = {&buffer[0], &buffer[width], &buffer[2 * width]};
+			float* sumVariance = &buffer[3 * width];
+			float* sumWeight = &buffer[4 * width];
+			float* depthScale = &buffer[5 * width];
+			float* weight = &buffer[6 * width];
+			float* wn = &buffer[7 * width];
+			for(int y=r.begin(); y<r.end(); ++y){
+				const int row = y * width;
+				std::fill(buffer.begin(), buffer.begin() + 5 * width, 0.f);
+				for(int x=0; x<width; ++x)
+					depthScale[x] = sigmaDepth * depthGradient[row + x];
+
+				for(int dy=-2; dy<=2; ++dy){
+					const int qy = y + dy * step;
+					if(qy < 0 || qy >= height)
+						continue;
+					for(int dx=-2; dx<=2; ++dx){
+						const int offset = dx * step;
+						const int xBegin = std::max(0, -offset), xEnd = std::min(width, width - offset);
+						if(xBegin >= xEnd)
+							continue;
+						const float h = B3Spline[dy + 2] * B3Spline[dx + 2];
+						const float dist = step * std::sqrt((float)(dx * dx + dy * dy));
+						// tap q of the center pixel row + x is at q + x
+						const int q = qy * width + offset;
+
+						for(int x=xBegin; x<xEnd; ++x)
+							wn[x] = std::max(0.f, n0[row + x] * n0[q + x] +
+								n1[row + x] * n1[q + x] + n2[row + x] * n2[q + x]);
+						for(int k=0; k<normalSquarings; ++k)
+							for(int x=xBegin; x<xEnd; ++x)
+								wn[x] *= wn[x];
+						for(int x=xBegin; x<xEnd; ++x){
+							// the tighter of the two, a noise free pixel next to a noisy one takes
+							// nothing from it
+							const float sp = invSigmaLuminance[row + x], sq = invSigmaLuminance[q + x];
+							const float el = std::abs(luminance[row + x] - luminance[q + x]) * 
+								(sp > sq ? sp : sq);
+							const float ez = std::abs(depth[row + x] - depth[q + x]) /
+								(depthScale[x] * dist + 1e-4f);
+							weight[x] = h * wn[x] * ExpNegative(-el - ez);
+						}
+						for(int c=0; c<3; ++c){
+							const float* in = color[c].data();
+							for(int x=xBegin; x<xEnd; ++x)
+								sum[c][x] += weight[x] * in[q + x];
+						}
+						for(int x=xBegin; x<xEnd; ++x){
+							sumVariance[x] += weight[x] * weight[x] * variance[q + x];
+							sumWeight[x] += weight[x];
+						}
+					}
+				}
+
+				// pixels without a first hit have a zero normal and keep their value
+				for(int x=0; x<width; ++x){
+					const float w = sumWeight[x], invW = w > 0.f ? 1.f / w : 0.f;
+					for(int c=0; c<3; ++c)
+						filtered[c][row + x] = w > 0.f ? sum[c][x] * invW : color[c][row + x];
+					filteredVariance[row + x] = w > 0.f ? sumVariance[x] * invW * invW : variance[row + x];
+				}
+			}
+		});
+		for(int c=0; c<3; ++c)
+			std::swap(color[c], filtered[c]);
+		std::swap(variance, filteredVariance);
+		if(iteration + 1 < iterations)
+			computeLuminance();
+	}
+
+	std::vector<Spectrum> result(nPixels);
+	parallelRows([&](int y){
+		for(int i=y*width; i<(y+1)*width; ++i)
+			for(int c=0; c<3; ++c)
+				result[i][c] = color[c][i] * albedo[c][i];
+	});
+	return result;
+}
+
+RIGA_NAMESPACE_END
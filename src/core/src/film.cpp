@@ -1,19 +1,398 @@
 #include <core/film.h>
-#include <fstream>
+#include <core/integrator.h>
+#include <cstdio>
+#include <cctype>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 RIGA_NAMESPACE_BEGIN
 
-void Film::write2PPM(const std::vector<Spectrum>& framebuffer){
+// the binary formats are little endian, as are the hosts we build for
+template <typename T>
+static void append(std::vector<uint8_t>& data, const T& value){
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	data.insert(data.end(), bytes, bytes + sizeof(T));
+}
+
+static void appendString(std::vector<uint8_t>& data, const char* str){
+	data.insert(data.end(), str, str + strlen(str) + 1);
+}
+
+static bool hasExtension(const std::string& name, const std::string& ext){
+	if(name.size() < ext.size())
+		return false;
+	for(size_t i=0; i<ext.size(); ++i)
+		if(std::tolower(name[name.size() - ext.size() + i]) != ext[i])
+			return false;
+	return true;
+}
+
+FilmTile::FilmTile(const Bounds2i& pixelBounds, const Vec2f& filterRadius, 
+	const float* filterTable, int filterTableWidth)
+	: pixelBounds(pixelBounds), width(std::max(0, pixelBounds.pMax.x - pixelBounds.pMin.x)),
+	  filterRadius(filterRadius), invFilterRadius(1.f / filterRadius.x, 1.f / filterRadius.y),
+	  filterTable(filterTable), filterTableWidth(filterTableWidth),
+	  pixels(width * std::max(0, pixelBounds.pMax.y - pixelBounds.pMin.y)),
+	  ifx((int)std::ceil(2.f * filterRadius.x) + 1), ify((int)std::ceil(2.f * filterRadius.y) + 1){}
+
+void FilmTile::addSample(const Point2f& pFilm, const Spectrum& L, float sampleWeight){
+	// pixel x reaches from x - 0.5 to x + 0.5 in raster space. it takes the samples whose
+	// distance d to its center is in (-radius, radius], the half open interval keeps a 
+	// sample on the border of two box filtered pixels out of one of them
+	const float dx = pFilm.x - 0.5f, dy = pFilm.y - 0.5f;
+	const int x0 = std::max((int)std::floor(dx - filterRadius.x) + 1, pixelBounds.pMin.x);
+	const int x1 = std::min((int)std::floor(dx + filterRadius.x) + 1, pixelBounds.pMax.x);
+	const int y0 = std::max((int)std::floor(dy - filterRadius.y) + 1, pixelBounds.pMin.y);
+	const int y1 = std::min((int)std::floor(dy + filterRadius.y) + 1, pixelBounds.pMax.y);
+
+	for(int x=x0; x<x1; ++x)
+		ifx[x - x0] = std::min((int)(std::abs(x - dx) * invFilterRadius.x * filterTableWidth), 
+			filterTableWidth - 1);
+	for(int y=y0; y<y1; ++y)
+		ify[y - y0] = std::min((int)(std::abs(y - dy) * invFilterRadius.y * filterTableWidth), 
+			filterTableWidth - 1);
+
+	for(int y=y0; y<y1; ++y)
+		for(int x=x0; x<x1; ++x){
+			const float filterWeight = filterTable[ify[y - y0] * filterTableWidth + ifx[x - x0]];
+			FilmTilePixel& pixel = getPixel(Point2i(x, y));
+			pixel.contribSum += L * sampleWeight * filterWeight;
+			pixel.filterWeightSum += filterWeight;
+		}
+}
+
+Film::Film(const Point2i& resolution, const std::string& file_name, std::unique_ptr<Filter> filt)
+	: fullResolution(resolution), fileName(file_name), filter(std::move(filt)),
+	  filterRadius(filter ? filter->radius : Vec2f(0.5f, 0.5f)){
+	for(int y=0; y<FilterTableWidth; ++y)
+		for(int x=0; x<FilterTableWidth; ++x){
+			Point2f p((x + 0.5f) * filterRadius.x / FilterTableWidth, 
+					  (y + 0.5f) * filterRadius.y / FilterTableWidth);
+			filterTable[y * FilterTableWidth + x] = filter ? filter->evaluate(p) : 1.f;
+		}
+}
+
+std::unique_ptr<FilmTile> Film::getFilmTile(const Bounds2i& sampleBounds) const{
+	// the pixels reached by samples in sampleBounds, see FilmTile::addSample
+	Bounds2i pixelBounds;
+	pixelBounds.pMin = Point2i(
+		std::max((int)std::floor(sampleBounds.pMin.x - 0.5f - filterRadius.x) + 1, 0),
+		std::max((int)std::floor(sampleBounds.pMin.y - 0.5f - filterRadius.y) + 1, 0));
+	pixelBounds.pMax = Point2i(
+		std::min((int)std::floor(sampleBounds.pMax.x - 0.5f + filterRadius.x) + 1, fullResolution.x),
+		std::min((int)std::floor(sampleBounds.pMax.y - 0.5f + filterRadius.y) + 1, fullResolution.y));
+	return std::unique_ptr<FilmTile>(new FilmTile(pixelBounds, filterRadius, 
+		filterTable, FilterTableWidth));
+}
+
+void Film::mergeFilmTile(const FilmTile& tile){
+	for(int y=tile.pixelBounds.pMin.y; y<tile.pixelBounds.pMax.y; ++y)
+		for(int x=tile.pixelBounds.pMin.x; x<tile.pixelBounds.pMax.x; ++x){
+			const FilmTilePixel& tilePixel = tile.getPixel(Point2i(x, y));
+			if(tilePixel.aov.weightSum > 0.f && !aovs.empty())
+				aovs[y * fullResolution.x + x].add(tilePixel.aov);
+			if(tilePixel.filterWeightSum == 0.f)
+				continue;
+			Pixel& pixel = pixelAt(x, y);
+			for(int c=0; c<3; ++c)
+				pixel.rgb[c].add(tilePixel.contribSum[c]);
+			pixel.filterWeightSum.add(tilePixel.filterWeightSum);
+		}
+}
+
+Film::~Film(){
+	closeStream();
+}
+
+void Film::clear(){
+	// allocated here rather than in the constructor, a film set to streaming never holds
+	// all the pixels
+	const size_t nPixels = (streamRows > 0 ? streamRows : fullResolution.y) * fullResolution.x;
+	if(pixels.size() != nPixels)
+		pixels = std::vector<Pixel>(nPixels);
+	for(Pixel& pixel : pixels){
+		for(int c=0; c<3; ++c)
+			pixel.rgb[c] = 0.f;
+		pixel.filterWeightSum = 0.f;
+	}
+	aovs = std::vector<AOVPixel>(denoiser ? fullResolution.x * fullResolution.y : 0);
+	closeStream();
+	rowsFinished = 0;
+}
+
+void Film::setStreaming(){
+	if(!hasExtension(fileName, ".pfm"))
+		throw("A streaming film writes .pfm files only!");
+	if(denoiser)
+		throw("A streaming film can not be denoised!");
+	// rows of a band of tiles plus the rows its samples reach above and below it
+	streamRows = std::min(SamplerIntegrator::TileSize + (int)std::ceil(2.f * filterRadius.y) + 2, fullResolution.y);
+	clear();
+}
+
+void Film::finishRows(int y){
+	// samples at rows >= y reach pixels down to floor(y - 0.5 - radius) + 1
+	const int lastRow = y >= fullResolution.y ? fullResolution.y : 
+		std::max(0, (int)std::floor(y - 0.5f - filterRadius.y) + 1);
+	if(lastRow <= rowsFinished)
+		return;
+
+	const int width = fullResolution.x, height = fullResolution.y;
+	const size_t rowSize = 3 * sizeof(float) * width;
+	if(!stream){
+		char header[64];
+		streamHeaderSize = snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", width, height);
+		streamSize = streamHeaderSize + rowSize * height;
+		int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+			throw("Film can not open the output file!");
+		if(ftruncate(fd, streamSize) != 0){
+			close(fd);
+			throw("Film can not resize the output file!");
+		}
+		void* mapping = mmap(nullptr, streamSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(mapping == MAP_FAILED)
+			throw("Film can not map the output file!");
+		stream = (uint8_t*)mapping;
+		memcpy(stream, header, streamHeaderSize);
+		streamReleased = streamSize;
+	}
+
+	for(; rowsFinished < lastRow; ++rowsFinished){
+		// pfm rows go from the bottom to the top
+		float* out = (float*)(stream + streamHeaderSize + (height - 1 - rowsFinished) * rowSize);
+		for(int x=0; x<width; ++x){
+			Pixel& pixel = pixelAt(x, rowsFinished);
+			const float weightSum = pixel.filterWeightSum;
+			for(int c=0; c<3; ++c){
+				out[3 * x + c] = weightSum > 0.f ? std::max(0.f, pixel.rgb[c] / weightSum) : 0.f;
+				// the slot is reused by the row streamRows further down
+				pixel.rgb[c] = 0.f;
+			}
+			pixel.filterWeightSum = 0.f;
+		}
+	}
+
+	// hand the whole pages of the finished rows back to the kernel, which writes them out
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+	const size_t finishedBegin = streamHeaderSize + (height - rowsFinished) * rowSize;
+	const size_t releaseBegin = rowsFinished == height ? 0 : (finishedBegin + pageSize - 1) / pageSize * pageSize;
+	if(releaseBegin < streamReleased){
+		msync(stream + releaseBegin, streamReleased - releaseBegin, MS_ASYNC);
+		madvise(stream + releaseBegin, streamReleased - releaseBegin, MADV_DONTNEED);
+		streamReleased = releaseBegin;
+	}
+	if(rowsFinished == height)
+		closeStream();
+}
+
+void Film::closeStream(){
+	if(!stream)
+		return;
+	msync(stream, streamSize, MS_SYNC);
+	munmap(stream, streamSize);
+	stream = nullptr;
+}
+
+std::vector<Spectrum> Film::getImage() const{
+	if(isStreaming())
+		throw("A streaming film has no image in memory!");
+	std::vector<Spectrum> image(fullResolution.x * fullResolution.y, Spectrum(0.f));
+	for(size_t i=0; i<pixels.size(); ++i){
+		const float weightSum = pixels[i].filterWeightSum;
+		// negative lobes (Mitchell) may leave a pixel with a tiny or negative weight
+		if(weightSum <= 0.f)
+			continue;
+		for(int c=0; c<3; ++c)
+			image[i][c] = std::max(0.f, pixels[i].rgb[c] / weightSum);
+	}
+	return image;
+}
+
+void Film::getPixelSums(int i, Spectrum* contribSum, float* filterWeightSum) const{
+	if(isStreaming())
+		throw("A streaming film has no image in memory!");
+	for(int c=0; c<3; ++c)
+		(*contribSum)[c] = pixels[i].rgb[c];
+	*filterWeightSum = pixels[i].filterWeightSum;
+}
+
+void Film::setPixelSums(int i, const Spectrum& contribSum, float filterWeightSum){
+	if(isStreaming())
+		throw("A streaming film has no image in memory!");
+	for(int c=0; c<3; ++c)
+		pixels[i].rgb[c] = contribSum[c];
+	pixels[i].filterWeightSum = filterWeightSum;
+}
+
+AOVPixel Film::getPixelAOVs(int i) const{
+	return aovs.empty() ? AOVPixel() : aovs[i];
+}
+
+void Film::setPixelAOVs(int i, const AOVPixel& aov){
+	if(!aovs.empty())
+		aovs[i] = aov;
+}
+
+void Film::setDenoiser(std::unique_ptr<Denoiser> d){
+	if(d && isStreaming())
+		throw("A streaming film can not be denoised!");
+	denoiser = std::move(d);
+	aovs = std::vector<AOVPixel>(denoiser ? fullResolution.x * fullResolution.y : 0);
+}
+
+DenoiserFeatures Film::getFeatures() const{
+	DenoiserFeatures features(fullResolution.x, fullResolution.y);
+	for(size_t i=0; i<aovs.size(); ++i){
+		if(aovs[i].weightSum == 0.f)
+			continue;
+		const float invWeight = 1.f / aovs[i].weightSum;
+		const Normal3f& n = aovs[i].sum.normal;
+		const float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		const float invLength = length > 0.f ? 1.f / length : 0.f;
+		for(int c=0; c<3; ++c)
+			features.albedo[c][i] = aovs[i].sum.albedo[c] * invWeight;
+		features.normal[0][i] = n.x * invLength;
+		features.normal[1][i] = n.y * invLength;
+		features.normal[2][i] = n.z * invLength;
+		features.depth[i] = aovs[i].sum.depth * invWeight;
+		// of the mean, unknown for fewer than two samples
+		if(aovs[i].weightSum > 1.f){
+			const float mean = aovs[i].luminanceSum * invWeight;
+			features.variance[i] = std::max(0.f, aovs[i].luminanceSquaredSum * invWeight - mean * mean) * 
+				invWeight * aovs[i].weightSum / (aovs[i].weightSum - 1.f);
+		}
+	}
+	return features;
+}
+
+void Film::writeImage() const{
+	std::vector<Spectrum> framebuffer = getImage();
+	if(denoiser)
+		framebuffer = denoiser->denoise(framebuffer, getFeatures());
+	if(hasExtension(fileName, ".pfm"))
+		write2PFM(framebuffer);
+	else if(hasExtension(fileName, ".exr"))
+		write2EXR(framebuffer);
+	else
+		write2PPM(framebuffer);
+}
+
+void Film::writeFile(const std::vector<uint8_t>& data) const{
 	FILE* fp = fopen(fileName.c_str(), "wb");
-    (void)fprintf(fp, "P6\n%d %d\n255\n", fullResolution.x, fullResolution.y);
-    for (auto i = 0; i < fullResolution.x * fullResolution.y; ++i) {
-        static unsigned char color[3];
-        color[0] = (unsigned char)(255 * Clamp(0, 1, framebuffer[i][0]));
-        color[1] = (unsigned char)(255 * Clamp(0, 1, framebuffer[i][1]));
-        color[2] = (unsigned char)(255 * Clamp(0, 1, framebuffer[i][2]));
-        fwrite(color, 1, 3, fp);
-    }
-    fclose(fp); 
-}
-
-RIGA_NAMESPACE_END
\ No newline at end of file
+	if(!fp)
+		throw("Film can not open the output file!");
+	const size_t written = fwrite(data.data(), 1, data.size(), fp);
+	fclose(fp);
+	if(written != data.size())
+		throw("Film can not write the output file!");
+}
+
+void Film::write2PPM(const std::vector<Spectrum>& framebuffer) const{
+	const int nPixels = fullResolution.x * fullResolution.y;
+	char header[64];
+	const int headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", 
+		fullResolution.x, fullResolution.y);
+	std::vector<uint8_t> data(header, header + headerSize);
+	data.reserve(headerSize + 3 * nPixels);
+	for(int i=0; i<nPixels; ++i)
+		for(int c=0; c<3; ++c)
+			data.push_back((uint8_t)(255 * Clamp(framebuffer[i][c], 0.f, 1.f)));
+	writeFile(data);
+}
+
+void Film::write2PFM(const std::vector<Spectrum>& framebuffer) const{
+	// a negative scale marks little endian data, rows go from the bottom to the top
+	char header[64];
+	const int headerSize = snprintf(header, sizeof(header), "PF\n%d %d\n-1.0\n", 
+		fullResolution.x, fullResolution.y);
+	std::vector<uint8_t> data(header, header + headerSize);
+	data.reserve(headerSize + 3 * sizeof(float) * fullResolution.x * fullResolution.y);
+	for(int y=fullResolution.y-1; y>=0; --y)
+		for(int x=0; x<fullResolution.x; ++x){
+			const Spectrum& L = framebuffer[y * fullResolution.x + x];
+			for(int c=0; c<3; ++c)
+				append(data, L[c]);
+		}
+	writeFile(data);
+}
+
+void Film::write2EXR(const std::vector<Spectrum>& framebuffer) const{
+	const int width = fullResolution.x, height = fullResolution.y;
+	std::vector<uint8_t> data;
+	data.reserve(1024 + height * (sizeof(uint64_t) + 2 * sizeof(int32_t)) + 
+		3 * sizeof(float) * width * height);
+
+	// magic number and version 2, single part scanline file
+	append(data, (int32_t)20000630);
+	append(data, (int32_t)2);
+
+	// header attributes : name, type, size and value. channels are sorted by name
+	const char* channels[3] = {"B", "G", "R"};
+	appendString(data, "channels");
+	appendString(data, "chlist");
+	append(data, (int32_t)(3 * (2 + 16) + 1));
+	for(const char* name : channels){
+		appendString(data, name);
+		append(data, (int32_t)2);	// FLOAT
+		append(data, (int32_t)0);	// pLinear and reserved
+		append(data, (int32_t)1);	// x sampling
+		append(data, (int32_t)1);	// y sampling
+	}
+	data.push_back(0);
+
+	appendString(data, "compression");
+	appendString(data, "compression");
+	append(data, (int32_t)1);
+	data.push_back(0);	// NO_COMPRESSION
+
+	const int32_t window[4] = {0, 0, width - 1, height - 1};
+	for(const char* name : {"dataWindow", "displayWindow"}){
+		appendString(data, name);
+		appendString(data, "box2i");
+		append(data, (int32_t)sizeof(window));
+		append(data, window);
+	}
+
+	appendString(data, "lineOrder");
+	appendString(data, "lineOrder");
+	append(data, (int32_t)1);
+	data.push_back(0);	// INCREASING_Y
+
+	appendString(data, "pixelAspectRatio");
+	appendString(data, "float");
+	append(data, (int32_t)4);
+	append(data, 1.f);
+
+	appendString(data, "screenWindowCenter");
+	appendString(data, "v2f");
+	append(data, (int32_t)8);
+	append(data, 0.f);
+	append(data, 0.f);
+
+	appendString(data, "screenWindowWidth");
+	appendString(data, "float");
+	append(data, (int32_t)4);
+	append(data, 1.f);
+	data.push_back(0);
+
+	// offset table, one uncompressed block per scanline
+	const int32_t lineSize = 3 * sizeof(float) * width;
+	const uint64_t firstLine = data.size() + height * sizeof(uint64_t);
+	for(int y=0; y<height; ++y)
+		append(data, (uint64_t)(firstLine + y * (2 * sizeof(int32_t) + lineSize)));
+
+	// a scanline holds its y, its size and then every channel of the row in turn
+	for(int y=0; y<height; ++y){
+		append(data, (int32_t)y);
+		append(data, lineSize);
+		for(int c=2; c>=0; --c)
+			for(int x=0; x<width; ++x)
+				append(data, framebuffer[y * width + x][c]);
+	}
+	writeFile(data);
+}
+
+RIGA_NAMESPACE_END
@@ -3,33 +3,394 @@
 #include <core/interaction.h>
 #include <core/scene.h>
 #include <core/light.h>
+#include <core/primitive.h>
+#include <core/memory.h>
+#include <tbb/parallel_for.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/task_arena.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 
 RIGA_NAMESPACE_BEGIN
+
+void SamplerIntegrator::setAdaptiveSampling(float maxError, int minSamples, float maxSampleFactor){
+	adaptiveMaxError = maxError;
+	adaptiveMinSamples = std::max(2, minSamples);
+	adaptiveMaxSampleFactor = std::max(1.f, maxSampleFactor);
+}
+
+void SamplerIntegrator::setProgressive(float timeBudget, float maxError, int64_t maxSpp){
+	progressiveTimeBudget = std::max(0.f, timeBudget);
+	progressiveMaxError = std::max(0.f, maxError);
+	progressiveMaxSpp = std::max<int64_t>(0, maxSpp);
+}
+
+void SamplerIntegrator::setCheckpoint(const std::string& fileName, float interval){
+	checkpointFile = fileName;
+	checkpointInterval = std::max(0.f, interval);
+}
+
+void SamplerIntegrator::setLightDistribution(const std::string& name){
+	lightDistributionName = name;
+}
+
 void SamplerIntegrator::render(const Scene& scene){
-	int m = 0;
-	int width = camera->film->fullResolution.x, height = camera->film->fullResolution.y;
-	std::vector<Spectrum> framebuffer(width * height);
-	for(int i=0; i<height; ++i){
-		for(int j=0; j<width; ++j){	
-			int offset = i * width + j;
-			std::unique_ptr<Sampler> pixel_sampler = sampler->clone(offset);
-			Point2i pixel(j, i);
-			pixel_sampler->startPixel(pixel);
-			Spectrum L(0.f);
-			do{
-				CameraSample cs = pixel_sampler->getCameraSample(pixel);
-				Ray r;
-				camera->generateRay(cs, &r);
-				L += Li(r, scene, *pixel_sampler);
-			}while(pixel_sampler->startNextSample());
-			framebuffer[m++] = L / (float)pixel_sampler->samplesPerPixel;
+	Film* film = camera->film;
+	const Point2i resolution = film->fullResolution;
+	const bool progressive = progressiveTimeBudget > 0.f || progressiveMaxError > 0.f;
+	if(film->isStreaming() && (progressive || !checkpointFile.empty()))
+		throw("A streaming film supports neither progressive rendering nor checkpoints!");
+	// a streaming film does not keep the statistics of the whole image, the tiles start
+	// from scratch
+	std::vector<PixelStats> stats(film->isStreaming() ? 0 : resolution.x * resolution.y);
+	film->clear();
+	if(!checkpointFile.empty() && loadCheckpoint(stats))
+		std::cout << "Resumed from " << checkpointFile << std::endl;
+	lastCheckpoint = std::chrono::steady_clock::now().time_since_epoch().count();
+	lightDistribution = CreateLightDistribution(lightDistributionName, scene);
+
+	if(progressive){
+		renderProgressive(scene, stats);
+		return;
+	}
+
+	// split the image into tiles
+	const Point2i nTiles((resolution.x + TileSize - 1) / TileSize, 
+						 (resolution.y + TileSize - 1) / TileSize);
+	// one arena and one sampler clone per render thread, reused by all the tiles the
+	// thread picks up. a sampler only needs startPixel to move to another pixel
+	tbb::enumerable_thread_specific<MemoryArena> arenas;
+	tbb::enumerable_thread_specific<std::unique_ptr<Sampler>> samplers([&](){
+		return sampler->clone(tbb::this_task_arena::current_thread_index());
+	});
+	std::atomic<int64_t> totalSamples(0);
+	auto renderTiles = [&](int tileBegin, int tileEnd){
+		tbb::parallel_for(tileBegin, tileEnd, [&](int tile){
+			Point2i tileMin((tile % nTiles.x) * TileSize, (tile / nTiles.x) * TileSize);
+			Point2i tileMax(std::min(tileMin.x + TileSize, resolution.x), 
+							std::min(tileMin.y + TileSize, resolution.y));
+			totalSamples += renderTile(scene, Bounds2i(tileMin, tileMax), *samplers.local(), 
+				arenas.local(), stats, sampler->samplesPerPixel, adaptiveMaxError > 0.f);
+		});
+	};
+	TICK_TBB(RENDER)
+	if(film->isStreaming()){
+		// one row of tiles after the other, the film writes out the rows behind them
+		for(int ty=0; ty<nTiles.y; ++ty){
+			renderTiles(ty * nTiles.x, (ty + 1) * nTiles.x);
+			film->finishRows(std::min((ty + 1) * TileSize, resolution.y));
+		}
+	}else
+		renderTiles(0, nTiles.x * nTiles.y);
+	TOCK_TBB(RENDER)
+	if(adaptiveMaxError > 0.f)
+		std::cout << "Average spp: " << (double)totalSamples / (resolution.x * resolution.y) << std::endl;
+	if(!checkpointFile.empty())
+		writeCheckpoint(stats);
+	if(!film->isStreaming())
+		film->writeImage();
+}
+
+void SamplerIntegrator::renderProgressive(const Scene& scene, std::vector<PixelStats>& stats){
+	Film* film = camera->film;
+	const Point2i resolution = film->fullResolution;
+
+	const Point2i nTiles((resolution.x + TileSize - 1) / TileSize, 
+						 (resolution.y + TileSize - 1) / TileSize);
+	// per thread arenas and samplers live across passes, every pass continues the
+	// sequences of the pixels through setSampleNumber
+	tbb::enumerable_thread_specific<MemoryArena> arenas;
+	tbb::enumerable_thread_specific<std::unique_ptr<Sampler>> samplers([&](){
+		return sampler->clone(tbb::this_task_arena::current_thread_index());
+	});
+
+	const auto start = std::chrono::steady_clock::now();
+	auto elapsed = [&](){
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+	auto outOfTime = [&](){
+		return progressiveTimeBudget > 0.f && elapsed() > progressiveTimeBudget;
+	};
+
+	// an error target the image never reaches (a single firefly keeps the mean up) must not
+	// double the passes forever
+	const int64_t maxSpp = progressiveMaxSpp > 0 ? progressiveMaxSpp :
+		std::max<int64_t>(1, sampler->samplesPerPixel * adaptiveMaxSampleFactor);
+	for(int64_t spp = 1; ; spp = std::min(2 * spp, maxSpp)){
+		tbb::parallel_for(0, nTiles.x * nTiles.y, [&](int tile){
+			// tiles left when the time is up keep the previous pass, the first one always completes
+			if(spp > 1 && outOfTime())
+				return;
+			Point2i tileMin((tile % nTiles.x) * TileSize, (tile / nTiles.x) * TileSize);
+			Point2i tileMax(std::min(tileMin.x + TileSize, resolution.x), 
+							std::min(tileMin.y + TileSize, resolution.y));
+			renderTile(scene, Bounds2i(tileMin, tileMax), *samplers.local(), arenas.local(), 
+				stats, spp, false);
+		});
+
+		float error = 0.f;
+		for(const PixelStats& s : stats)
+			error += s.error();
+		error /= stats.size();
+		film->writeImage();
+		std::cout << "Pass " << spp << " spp: " << elapsed() << "s, error " << error << std::endl;
+		if(outOfTime() || (progressiveMaxError > 0.f && error <= progressiveMaxError) || spp >= maxSpp)
+			break;
+	}
+	if(!checkpointFile.empty())
+		writeCheckpoint(stats);
+}
+
+int64_t SamplerIntegrator::renderTile(const Scene& scene, const Bounds2i& tileBounds, 
+	Sampler& tileSampler, MemoryArena& arena, std::vector<PixelStats>& imageStats, 
+	int64_t spp, bool adaptive) const{
+	Film* film = camera->film;
+	const int width = film->fullResolution.x;
+	const int tileWidth = tileBounds.pMax.x - tileBounds.pMin.x;
+	const int tileHeight = tileBounds.pMax.y - tileBounds.pMin.y;
+	auto pixelOf = [&](int k){
+		return Point2i(tileBounds.pMin.x + k % tileWidth, tileBounds.pMin.y + k / tileWidth);
+	};
+
+	// the tile works on copies of the statistics of its pixels, they are handed back
+	// together with the film tile so that a checkpoint never sees one without the other
+	std::vector<PixelStats> stats(tileBounds.area());
+	if(!imageStats.empty())
+		for(size_t k=0; k<stats.size(); ++k){
+			const Point2i pixel = pixelOf(k);
+			stats[k] = imageStats[pixel.y * width + pixel.x];
+		}
+	// samples are splatted into a tile of this thread, which is merged into the film at the end
+	std::unique_ptr<FilmTile> filmTile = film->getFilmTile(tileBounds);
+
+	// takes samples of pixel k until it holds n of them, its sequence simply continues
+	// from the samples it already has (earlier passes, adaptive rounds or a checkpoint)
+	auto sampleUpTo = [&](int k, int64_t n){
+		const Point2i pixel = pixelOf(k);
+		PixelStats& s = stats[k];
+		if(s.n >= n)
+			return;
+		tileSampler.startPixel(pixel);
+		while(s.n < n){
+			tileSampler.setSampleNumber(s.n);
+			CameraSample cs = tileSampler.getCameraSample(pixel);
+			Ray r;
+			float rayWeight = camera->generateRay(cs, &r);
+			const AOVSample aov = film->hasAOVs() ? firstHit(r, scene, arena) : AOVSample();
+			Spectrum L = Li(r, scene, tileSampler, arena);
+			if(film->hasAOVs())
+				filmTile->addAOV(pixel, aov, L);
+			filmTile->addSample(cs.samplePoints, L, rayWeight);
+			s.add(L);
+			arena.reset();
 		}
+	};
+
+	if(!adaptive){
+		for(size_t k=0; k<stats.size(); ++k)
+			sampleUpTo(k, spp);
+	}else{
+		// every round doubles the count of the noisy pixels, which keeps the low discrepancy
+		// samples stratified
+		const int64_t minSamples = std::min<int64_t>(adaptiveMinSamples, spp);
+		const int64_t maxSamples = std::max<int64_t>(spp, adaptiveMaxSampleFactor * spp);
+		for(size_t k=0; k<stats.size(); ++k)
+			sampleUpTo(k, minSamples);
+		int64_t budget = stats.size() * spp;
+		for(const PixelStats& s : stats)
+			budget -= s.n;
+
+		std::vector<float> error(stats.size());
+		std::vector<int> noisy;
+		while(budget > 0){
+			// the error of a pixel is the largest one in its 3x3 neighbourhood, so a pixel whose
+			// first samples all missed a small bright feature still gets refined with its neighbours
+			for(int y=0; y<tileHeight; ++y)
+				for(int x=0; x<tileWidth; ++x){
+					float e = 0.f;
+					for(int dy=std::max(0, y-1); dy<=std::min(tileHeight-1, y+1); ++dy)
+						for(int dx=std::max(0, x-1); dx<=std::min(tileWidth-1, x+1); ++dx)
+							e = std::max(e, stats[dy * tileWidth + dx].error());
+					error[y * tileWidth + x] = e;
+				}
+			noisy.clear();
+			for(size_t k=0; k<stats.size(); ++k)
+				if(error[k] > adaptiveMaxError && stats[k].n < maxSamples)
+					noisy.push_back(k);
+			if(noisy.empty())
+				break;
+
+			// noisiest first, they get the budget if it runs out within this round
+			std::sort(noisy.begin(), noisy.end(), [&](int a, int b){
+				return error[a] > error[b];
+			});
+			const int64_t budgetBefore = budget;
+			for(int k : noisy){
+				const int64_t n = std::min(2 * stats[k].n, maxSamples);
+				if(n - stats[k].n > budget)
+					break;
+				budget -= n - stats[k].n;
+				sampleUpTo(k, n);
+			}
+			if(budget == budgetBefore)
+				break;
+		}
+	}
+
+	{
+		std::shared_lock<std::shared_mutex> lock(checkpointMutex);
+		film->mergeFilmTile(*filmTile);
+		if(!imageStats.empty())
+			for(size_t k=0; k<stats.size(); ++k){
+				const Point2i pixel = pixelOf(k);
+				imageStats[pixel.y * width + pixel.x] = stats[k];
+			}
+	}
+	if(checkpointInterval > 0.f && !checkpointFile.empty()){
+		const std::chrono::steady_clock::duration sinceCheckpoint = 
+			std::chrono::steady_clock::now().time_since_epoch() - 
+			std::chrono::steady_clock::duration(lastCheckpoint.load());
+		if(std::chrono::duration<float>(sinceCheckpoint).count() > checkpointInterval)
+			writeCheckpoint(imageStats);
+	}
+
+	int64_t nSamples = 0;
+	for(const PixelStats& s : stats)
+		nSamples += s.n;
+	return nSamples;
+}
+
+AOVSample SamplerIntegrator::firstHit(const Ray& ray, const Scene& scene, MemoryArena& arena) const{
+	AOVSample aov;
+	// intersect moves tMax of the ray to the hit
+	Ray r = ray;
+	Spectrum throughput(1.f);
+	float distance = 0.f;
+	for(int bounce=0; bounce<=MaxAOVSpecularBounces; ++bounce){
+		SurfaceInteraction isect;
+		if(!scene.intersect(r, &isect))
+			break;
+		distance += r.tMax * r.dir.length();
+		const Material* material = isect.primitive->getMaterial();
+		aov.albedo = material ? throughput * material->albedo(isect) : Spectrum(0.f);
+		aov.normal = isect.shading.n;
+		aov.depth = distance;
+
+		// a mirror or glass shows the surface it reflects or refracts, a noisy reflection 
+		// has to be told apart by the features of that surface. glass takes the refraction
+		isect.computeScatteringFunctions(r, arena);
+		if(!isect.bsdf || isect.bsdf->getNumComponents() == 0 || 
+			isect.bsdf->getNumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0)
+			break;
+		Vec3f wi;
+		float pdf = 0.f;
+		const Spectrum f = isect.bsdf->sample_f(isect.wo, &wi, Point2f(0.5f, 0.5f), &pdf);
+		if(pdf == 0.f || f.isBlack())
+			break;
+		throughput *= f * AbsDot(wi, isect.shading.n) / pdf;
+		r = isect.spawnRay(wi);
+	}
+	return aov;
+}
+
+// checkpoint file : magic, version, width, height and then for every pixel the film sums
+// (rgb and filter weight), the pixel's statistics (mean, m2, sample count) and its AOV sums
+// (zero when the film has none)
+static constexpr uint32_t CheckpointMagic = 0x4b434452;	// "RDCK"
+static constexpr uint32_t CheckpointVersion = 2;
+
+struct CheckpointPixel{
+	float rgb[3], filterWeightSum;
+	float mean, m2;
+	int64_t n;
+	float albedo[3], normal[3], depth;
+	float luminanceSum, luminanceSquaredSum, aovWeightSum;
+};
+
+void SamplerIntegrator::writeCheckpoint(const std::vector<PixelStats>& stats) const{
+	// a single writer, the other threads keep rendering
+	if(checkpointWriting.exchange(true))
+		return;
+	const Film* film = camera->film;
+	const uint32_t header[4] = {CheckpointMagic, CheckpointVersion, 
+		(uint32_t)film->fullResolution.x, (uint32_t)film->fullResolution.y};
+	std::vector<CheckpointPixel> pixels(stats.size());
+	{
+		// merges are held off while the film and the statistics are copied
+		std::unique_lock<std::shared_mutex> lock(checkpointMutex);
+		for(size_t i=0; i<stats.size(); ++i){
+			Spectrum contribSum;
+			film->getPixelSums(i, &contribSum, &pixels[i].filterWeightSum);
+			for(int c=0; c<3; ++c)
+				pixels[i].rgb[c] = contribSum[c];
+			pixels[i].mean = stats[i].mean;
+			pixels[i].m2 = stats[i].m2;
+			pixels[i].n = stats[i].n;
+			const AOVPixel aov = film->getPixelAOVs(i);
+			for(int c=0; c<3; ++c)
+				pixels[i].albedo[c] = aov.sum.albedo[c];
+			pixels[i].normal[0] = aov.sum.normal.x;
+			pixels[i].normal[1] = aov.sum.normal.y;
+			pixels[i].normal[2] = aov.sum.normal.z;
+			pixels[i].depth = aov.sum.depth;
+			pixels[i].luminanceSum = aov.luminanceSum;
+			pixels[i].luminanceSquaredSum = aov.luminanceSquaredSum;
+			pixels[i].aovWeightSum = aov.weightSum;
+		}
+	}
+
+	// written next to the old checkpoint and renamed over it, a render killed while writing
+	// still has the previous one
+	const std::string tmpFile = checkpointFile + ".tmp";
+	FILE* fp = fopen(tmpFile.c_str(), "wb");
+	if(fp){
+		bool ok = fwrite(header, sizeof(header), 1, fp) == 1 &&
+			fwrite(pixels.data(), sizeof(CheckpointPixel), pixels.size(), fp) == pixels.size();
+		ok = (fclose(fp) == 0) && ok;
+		if(!ok || rename(tmpFile.c_str(), checkpointFile.c_str()) != 0)
+			std::cerr << "Can not write the checkpoint " << checkpointFile << std::endl;
+	}else
+		std::cerr << "Can not open the checkpoint " << tmpFile << std::endl;
+	lastCheckpoint = std::chrono::steady_clock::now().time_since_epoch().count();
+	checkpointWriting = false;
+}
+
+bool SamplerIntegrator::loadCheckpoint(std::vector<PixelStats>& stats) const{
+	FILE* fp = fopen(checkpointFile.c_str(), "rb");
+	if(!fp)
+		return false;
+	Film* film = camera->film;
+	uint32_t header[4];
+	std::vector<CheckpointPixel> pixels(stats.size());
+	const bool ok = fread(header, sizeof(header), 1, fp) == 1 && 
+		header[0] == CheckpointMagic && header[1] == CheckpointVersion &&
+		header[2] == (uint32_t)film->fullResolution.x && header[3] == (uint32_t)film->fullResolution.y &&
+		fread(pixels.data(), sizeof(CheckpointPixel), pixels.size(), fp) == pixels.size();
+	fclose(fp);
+	if(!ok){
+		std::cerr << "Ignoring the checkpoint " << checkpointFile << ", it does not match the film" << std::endl;
+		return false;
+	}
+	for(size_t i=0; i<stats.size(); ++i){
+		film->setPixelSums(i, Spectrum::fromRGB(pixels[i].rgb), pixels[i].filterWeightSum);
+		stats[i].mean = pixels[i].mean;
+		stats[i].m2 = pixels[i].m2;
+		stats[i].n = pixels[i].n;
+		AOVPixel aov;
+		aov.sum.albedo = Spectrum::fromRGB(pixels[i].albedo);
+		aov.sum.normal = Normal3f(pixels[i].normal[0], pixels[i].normal[1], pixels[i].normal[2]);
+		aov.sum.depth = pixels[i].depth;
+		aov.luminanceSum = pixels[i].luminanceSum;
+		aov.luminanceSquaredSum = pixels[i].luminanceSquaredSum;
+		aov.weightSum = pixels[i].aovWeightSum;
+		film->setPixelAOVs(i, aov);
 	}
-	camera->film->write2PPM(framebuffer);
+	return true;
 }
 
 Spectrum SamplerIntegrator::specularReflect(const Ray& ray, const SurfaceInteraction& isec, 
-	const Scene& scene, Sampler& sampler, int depth) const{
+	const Scene& scene, Sampler& sampler, MemoryArena& arena, int depth) const{
 	Vec3f wo = isec.wo, wi;
 	float pdf;
 
@@ -39,13 +400,13 @@ Spectrum SamplerIntegrator::specularReflect(const Ray& ray, const SurfaceInterac
 	const Normal3f& ns = isec.shading.n;
 	if(pdf > 0.f && !f.isBlack() && AbsDot(wi, ns) != 0.f){
 		Ray rd = isec.spawnRay(wi);
-		return f * Li(rd, scene, sampler, depth + 1) * AbsDot(wi, ns) / pdf;
+		return f * Li(rd, scene, sampler, arena, depth + 1) * AbsDot(wi, ns) / pdf;
 	}else
 		return Spectrum(0.f);
 }
 
 Spectrum SamplerIntegrator::specularTransmit(const Ray& ray, const SurfaceInteraction& isec, 
-	const Scene& scene, Sampler& sampler, int depth) const{
+	const Scene& scene, Sampler& sampler, MemoryArena& arena, int depth) const{
 	Vec3f wo = isec.wo, wi;
 	float pdf;
 
@@ -55,7 +416,7 @@ Spectrum SamplerIntegrator::specularTransmit(const Ray& ray, const SurfaceIntera
 	const Normal3f& ns = isec.shading.n;
 	if(pdf > 0.f && !f.isBlack() && AbsDot(wi, ns) != 0.f){
 		Ray rd = isec.spawnRay(wi);
-		return f * Li(rd, scene, sampler, depth + 1) * AbsDot(wi, ns) / pdf;
+		return f * Li(rd, scene, sampler, arena, depth + 1) * AbsDot(wi, ns) / pdf;
 	}else
 		return Spectrum(0.f);
 }
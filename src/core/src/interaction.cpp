@@ -14,8 +14,8 @@ void SurfaceInteraction::setShadingInfo(const Normal3f& shadingNormal){
 	shading.n = shadingNormal;
 }
 
-void SurfaceInteraction::computeScatteringFunctions(const Ray& ray, TransportMode mode){
-	primitive->computeScatteringFunctions(this, mode);
+void SurfaceInteraction::computeScatteringFunctions(const Ray& ray, MemoryArena& arena, TransportMode mode){
+	primitive->computeScatteringFunctions(this, arena, mode);
 }
 
 Spectrum SurfaceInteraction::Le(const Vec3f& w) const{
@@ -10,6 +10,61 @@ Light::Light(LightFlags flags, const Transform& light2world, int nSamples)
 AreaLight::AreaLight(const Transform& light2world, int nSamples)
 	: Light(LightFlags::Area, light2world, nSamples){ }
 
+// cos and sin of max(0, a - b) given those of a and b
+static float cosSubClamped(float sinA, float cosA, float sinB, float cosB){
+	return cosA > cosB ? 1.f : cosA * cosB + sinA * sinB;
+}
+static float sinSubClamped(float sinA, float cosA, float sinB, float cosB){
+	return cosA > cosB ? 0.f : sinA * cosB - cosA * sinB;
+}
+static float safeSqrt(float x){
+	return std::sqrt(std::max(0.f, x));
+}
+
+float LightBounds::importance(const Point3f& p, const Normal3f& n) const{
+	// the angle between w and the direction to p, less the angles the bounds subtend at p
+	// and the spread of the emission, bounds the angle the light leaves at towards p
+	const Point3f pc = centroid();
+	const float d2 = std::max(DistanceSquared(p, pc), bounds.diagnoal().length() / 2);
+	const Vec3f wi = Normalize(p - pc);
+	float cosThetaW = Dot(w, wi);
+	if(twoSided)
+		cosThetaW = std::abs(cosThetaW);
+	const float sinThetaW = safeSqrt(1.f - cosThetaW * cosThetaW);
+
+	// the bounding sphere of the bounds seen from p
+	const float radius2 = DistanceSquared(pc, bounds.pMax);
+	const float cosThetaB = DistanceSquared(p, pc) < radius2 ? -1.f : 
+		safeSqrt(1.f - radius2 / DistanceSquared(p, pc));
+	const float sinThetaB = safeSqrt(1.f - cosThetaB * cosThetaB);
+
+	const float sinThetaO = safeSqrt(1.f - cosThetaO * cosThetaO);
+	const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if(cosThetaP <= cosThetaE)
+		return 0.f;
+	float result = phi * cosThetaP / d2;
+
+	// the light arrives at p within the bounds' angle of -wi
+	if(n.x != 0.f || n.y != 0.f || n.z != 0.f){
+		const float cosThetaI = AbsDot(wi, n);
+		const float sinThetaI = safeSqrt(1.f - cosThetaI * cosThetaI);
+		result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+	return std::max(result, 0.f);
+}
+
+LightBounds Union(const LightBounds& a, const LightBounds& b){
+	if(a.phi == 0.f)
+		return b;
+	if(b.phi == 0.f)
+		return a;
+	const DirectionCone cone = Union(DirectionCone(a.w, a.cosThetaO), DirectionCone(b.w, b.cosThetaO));
+	return LightBounds(Union(a.bounds, b.bounds), cone.w, a.phi + b.phi, cone.cosTheta,
+		std::min(a.cosThetaE, b.cosThetaE), a.twoSided || b.twoSided);
+}
+
 bool VisibilityTester::unoccluded(const Scene& scene) const{
 	return !scene.intersectP(p0.spawnRayTo(p1));
 }
@@ -0,0 +1,307 @@
+#include <core/lightdistrib.h>
+#include <core/scene.h>
+#include <core/spectrum.h>
+#include <core/lowdiscrepancy.h>
+#include <algorithm>
+
+RIGA_NAMESPACE_BEGIN
+
+std::unique_ptr<LightDistribution> CreateLightDistribution(const std::string& name, const Scene& scene){
+	if(name.empty())
+		return nullptr;
+	if(name == "power")
+		return std::unique_ptr<LightDistribution>(new PowerLightDistribution(scene.lights));
+	if(name == "spatial")
+		return std::unique_ptr<LightDistribution>(new SpatialLightDistribution(scene));
+	if(name == "bvh")
+		return std::unique_ptr<LightDistribution>(new BVHLightDistribution(scene.lights));
+	throw("Unknown light distribution!");
+}
+
+PowerLightDistribution::PowerLightDistribution(const std::vector<std::shared_ptr<Light>>& sceneLights)
+	: lights(sceneLights){
+	// the power summed over the channels
+	std::vector<float> lightPower(lights.size());
+	for(size_t i=0; i<lights.size(); ++i){
+		const Spectrum phi = lights[i]->power();
+		lightPower[i] = phi[0] + phi[1] + phi[2];
+		lightToIndex[lights[i].get()] = i;
+	}
+	aliasTable = AliasTable(lightPower);
+}
+
+const Light* PowerLightDistribution::sample(const Interaction& ref, float u, float* pmf) const{
+	const int index = aliasTable.sample(u, pmf);
+	return index < 0 ? nullptr : lights[index].get();
+}
+
+float PowerLightDistribution::pmf(const Interaction& ref, const Light* light) const{
+	auto iter = lightToIndex.find(light);
+	return iter == lightToIndex.end() ? 0.f : aliasTable.pmf(iter->second);
+}
+
+BVHLightDistribution::BVHLightDistribution(const std::vector<std::shared_ptr<Light>>& sceneLights)
+	: lights(sceneLights){
+	std::vector<std::pair<int, LightBounds>> bvhLights;
+	for(size_t i=0; i<lights.size(); ++i){
+		const LightBounds lightBounds = lights[i]->bounds();
+		if(lightBounds.phi > 0.f)
+			bvhLights.push_back(std::make_pair(i, lightBounds));
+	}
+	if(!bvhLights.empty())
+		build(bvhLights, 0, bvhLights.size(), 0, 0);
+}
+
+SpatialLightDistribution::SpatialLightDistribution(const Scene& scene, int maxVoxels)
+	: scene(scene), lights(scene.lights){
+	for(size_t i=0; i<lights.size(); ++i)
+		lightToIndex[lights[i].get()] = i;
+	// cube shaped voxels, at least one along each axis
+	const Bounds3f& b = scene.worldBound();
+	const Vec3f diag = b.diagnoal();
+	const float maxExtent = diag.maxComponent();
+	for(int i=0; i<3; ++i)
+		nVoxels[i] = maxExtent > 0.f ? 
+			std::max(1, std::min(maxVoxels, (int)std::round(diag[i] / maxExtent * maxVoxels))) : 1;
+	// four entries per voxel keep the probe sequences short
+	hashTableSize = 4 * (size_t)nVoxels[0] * nVoxels[1] * nVoxels[2];
+	hashTable.reset(new HashEntry[hashTableSize]);
+	for(size_t i=0; i<hashTableSize; ++i){
+		hashTable[i].packedPos.store(invalidPackedPos);
+		hashTable[i].distribution.store(nullptr);
+	}
+}
+
+SpatialLightDistribution::~SpatialLightDistribution(){
+	for(size_t i=0; i<hashTableSize; ++i)
+		delete hashTable[i].distribution.load();
+}
+
+const AliasTable& SpatialLightDistribution::lookup(const Point3f& p) const{
+	// points outside the bounds go to the nearest voxel, a flat axis has one
+	const Bounds3f& b = scene.worldBound();
+	int voxel[3];
+	for(int i=0; i<3; ++i){
+		const float extent = b.pMax[i] - b.pMin[i];
+		const float offset = extent > 0.f ? Clamp((p[i] - b.pMin[i]) / extent, 0.f, 1.f) : 0.f;
+		voxel[i] = std::min((int)(offset * nVoxels[i]), nVoxels[i] - 1);
+	}
+	const uint64_t packedPos = ((uint64_t)voxel[0] << 40) | ((uint64_t)voxel[1] << 20) | voxel[2];
+
+	// murmur3 finalizer of the packed position, then linear probing
+	uint64_t hash = packedPos;
+	hash ^= hash >> 31;
+	hash *= 0x7fb5d329728ea185;
+	hash ^= hash >> 27;
+	hash *= 0x81dadef4bc2dd44d;
+	hash ^= hash >> 33;
+	hash %= hashTableSize;
+	for(;;){
+		HashEntry& entry = hashTable[hash];
+		uint64_t entryPackedPos = entry.packedPos.load(std::memory_order_acquire);
+		if(entryPackedPos == packedPos){
+			// another thread may still be filling it in
+			AliasTable* distribution;
+			while((distribution = entry.distribution.load(std::memory_order_acquire)) == nullptr)
+				;
+			return *distribution;
+		}
+		if(entryPackedPos == invalidPackedPos &&
+			entry.packedPos.compare_exchange_strong(entryPackedPos, packedPos)){
+			AliasTable* distribution = computeDistribution(voxel);
+			entry.distribution.store(distribution, std::memory_order_release);
+			return *distribution;
+		}
+		// the entry was taken, by this voxel if the exchange lost to it
+		if(entryPackedPos == packedPos)
+			continue;
+		if(++hash == hashTableSize)
+			hash = 0;
+	}
+}
+
+AliasTable* SpatialLightDistribution::computeDistribution(int voxel[3]) const{
+	const Bounds3f& b = scene.worldBound();
+	Point3f p0, p1;
+	for(int i=0; i<3; ++i){
+		p0[i] = b.pMin[i] + (b.pMax[i] - b.pMin[i]) * voxel[i] / nVoxels[i];
+		p1[i] = b.pMin[i] + (b.pMax[i] - b.pMin[i]) * (voxel[i] + 1) / nVoxels[i];
+	}
+
+	// the unoccluded light at halton points of the voxel, from every side
+	constexpr int nSamples = 128;
+	std::vector<float> lightContrib(lights.size(), 0.f);
+	for(int i=0; i<nSamples; ++i){
+		const Point3f p(p0.x + (p1.x - p0.x) * RadicalInverse(0, i), 
+			p0.y + (p1.y - p0.y) * RadicalInverse(1, i), p0.z + (p1.z - p0.z) * RadicalInverse(2, i));
+		const Interaction ref(p, 0.f);
+		const Point2f u(RadicalInverse(3, i), RadicalInverse(4, i));
+		for(size_t j=0; j<lights.size(); ++j){
+			Vec3f wi;
+			float pdf;
+			VisibilityTester vis;
+			const Spectrum Li = lights[j]->sample_Li(ref, u, &wi, &pdf, &vis);
+			if(pdf > 0.f)
+				lightContrib[j] += (Li[0] + Li[1] + Li[2]) / pdf;
+		}
+	}
+
+	// a light missed by the samples may still reach a part of the voxel
+	float sumContrib = 0.f;
+	for(float contrib : lightContrib)
+		sumContrib += contrib;
+	const float avgContrib = sumContrib / (nSamples * lightContrib.size());
+	const float minContrib = avgContrib > 0.f ? 0.001f * avgContrib : 1.f;
+	for(float& contrib : lightContrib)
+		contrib = std::max(contrib, minContrib);
+	return new AliasTable(lightContrib);
+}
+
+const Light* SpatialLightDistribution::sample(const Interaction& ref, float u, float* pmf) const{
+	if(lights.empty())
+		return nullptr;
+	const int index = lookup(ref.p).sample(u, pmf);
+	return index < 0 ? nullptr : lights[index].get();
+}
+
+float SpatialLightDistribution::pmf(const Interaction& ref, const Light* light) const{
+	auto iter = lightToIndex.find(light);
+	return iter == lightToIndex.end() ? 0.f : lookup(ref.p).pmf(iter->second);
+}
+
+// cost of a split candidate (pbrt-v4) : power times the solid angle measure of the emission
+// cone times the surface area, stretched bounds penalized along dim
+static float evaluateCost(const LightBounds& b, const Bounds3f& bounds, int dim){
+	const float thetaO = std::acos(Clamp(b.cosThetaO, -1.f, 1.f));
+	const float thetaE = std::acos(Clamp(b.cosThetaE, -1.f, 1.f));
+	const float thetaW = std::min(thetaO + thetaE, PI);
+	const float sinThetaO = std::sqrt(std::max(0.f, 1.f - b.cosThetaO * b.cosThetaO));
+	const float mOmega = 2 * PI * (1 - b.cosThetaO) + PI / 2 *
+		(2 * thetaW * sinThetaO - std::cos(thetaO - 2 * thetaW) - 2 * thetaO * sinThetaO + b.cosThetaO);
+	const Vec3f d = bounds.diagnoal();
+	const float kr = d.maxComponent() / d[dim];
+	return b.phi * mOmega * kr * b.bounds.surfaceArea();
+}
+
+int BVHLightDistribution::build(std::vector<std::pair<int, LightBounds>>& bvhLights,
+	int start, int end, uint64_t bitTrail, int depth){
+	if(depth >= 64)
+		throw("The light BVH is too deep!");
+	if(end - start == 1){
+		const int nodeIndex = nodes.size();
+		nodes.push_back(Node{bvhLights[start].second, bvhLights[start].first, true});
+		bitTrails[lights[bvhLights[start].first].get()] = bitTrail;
+		return nodeIndex;
+	}
+
+	Bounds3f bounds, centroidBounds;
+	for(int i=start; i<end; ++i){
+		bounds = Union(bounds, bvhLights[i].second.bounds);
+		centroidBounds = Union(centroidBounds, bvhLights[i].second.centroid());
+	}
+
+	// the cheapest of the bucket boundaries along the three axes
+	constexpr int nBuckets = 12;
+	float minCost = Infinity;
+	int minBucket = -1, minDim = -1;
+	auto bucketOf = [&](const LightBounds& lightBounds, int dim){
+		const int b = nBuckets * centroidBounds.offset(lightBounds.centroid())[dim];
+		return std::min(std::max(b, 0), nBuckets - 1);
+	};
+	for(int dim=0; dim<3; ++dim){
+		if(centroidBounds.pMax[dim] == centroidBounds.pMin[dim])
+			continue;
+		LightBounds bucketBounds[nBuckets];
+		for(int i=start; i<end; ++i){
+			LightBounds& b = bucketBounds[bucketOf(bvhLights[i].second, dim)];
+			b = Union(b, bvhLights[i].second);
+		}
+		for(int i=0; i<nBuckets-1; ++i){
+			LightBounds b0, b1;
+			for(int j=0; j<=i; ++j)
+				b0 = Union(b0, bucketBounds[j]);
+			for(int j=i+1; j<nBuckets; ++j)
+				b1 = Union(b1, bucketBounds[j]);
+			const float cost = evaluateCost(b0, bounds, dim) + evaluateCost(b1, bounds, dim);
+			if(cost > 0.f && cost < minCost){
+				minCost = cost;
+				minBucket = i;
+				minDim = dim;
+			}
+		}
+	}
+
+	int mid = (start + end) / 2;
+	if(minDim != -1){
+		auto second = std::partition(bvhLights.begin() + start, bvhLights.begin() + end,
+			[&](const std::pair<int, LightBounds>& l){
+				return bucketOf(l.second, minDim) <= minBucket;
+			});
+		if(second != bvhLights.begin() + start && second != bvhLights.begin() + end)
+			mid = second - bvhLights.begin();
+	}
+
+	const int nodeIndex = nodes.size();
+	nodes.push_back(Node{LightBounds(), 0, false});
+	const int child0 = build(bvhLights, start, mid, bitTrail, depth + 1);
+	const int child1 = build(bvhLights, mid, end, bitTrail | (uint64_t(1) << depth), depth + 1);
+	nodes[nodeIndex] = Node{Union(nodes[child0].bounds, nodes[child1].bounds), child1, false};
+	return nodeIndex;
+}
+
+const Light* BVHLightDistribution::sample(const Interaction& ref, float u, float* pmf) const{
+	if(nodes.empty())
+		return nullptr;
+	int nodeIndex = 0;
+	float prob = 1.f;
+	for(;;){
+		const Node& node = nodes[nodeIndex];
+		if(node.isLeaf){
+			// a single light is the root, its importance has not been looked at yet
+			if(nodeIndex > 0 || node.bounds.importance(ref.p, ref.n) > 0.f){
+				*pmf = prob;
+				return lights[node.index].get();
+			}
+			return nullptr;
+		}
+		const float importance0 = nodes[nodeIndex + 1].bounds.importance(ref.p, ref.n);
+		const float importance1 = nodes[node.index].bounds.importance(ref.p, ref.n);
+		if(importance0 == 0.f && importance1 == 0.f)
+			return nullptr;
+		// u is stretched back to [0, 1) for the next choice
+		const float p0 = importance0 / (importance0 + importance1);
+		if(u < p0){
+			u = std::min(u / p0, OneMinusEpsilon);
+			prob *= p0;
+			++nodeIndex;
+		}else{
+			u = std::min((u - p0) / (1.f - p0), OneMinusEpsilon);
+			prob *= 1.f - p0;
+			nodeIndex = node.index;
+		}
+	}
+}
+
+float BVHLightDistribution::pmf(const Interaction& ref, const Light* light) const{
+	auto iter = bitTrails.find(light);
+	if(iter == bitTrails.end())
+		return 0.f;
+	uint64_t bitTrail = iter->second;
+	int nodeIndex = 0;
+	float prob = 1.f;
+	for(;;){
+		const Node& node = nodes[nodeIndex];
+		if(node.isLeaf)
+			return (nodeIndex > 0 || node.bounds.importance(ref.p, ref.n) > 0.f) ? prob : 0.f;
+		const float importance0 = nodes[nodeIndex + 1].bounds.importance(ref.p, ref.n);
+		const float importance1 = nodes[node.index].bounds.importance(ref.p, ref.n);
+		if(importance0 == 0.f && importance1 == 0.f)
+			return 0.f;
+		const bool second = bitTrail & 1;
+		prob *= (second ? importance1 : importance0) / (importance0 + importance1);
+		nodeIndex = second ? node.index : nodeIndex + 1;
+		bitTrail >>= 1;
+	}
+}
+
+RIGA_NAMESPACE_END
@@ -0,0 +1,63 @@
+#include <core/memory.h>
+#include <cstdlib>
+
+RIGA_NAMESPACE_BEGIN
+
+static uint8_t* allocAligned(size_t size){
+	// aligned_alloc wants a multiple of the alignment
+	return (uint8_t*)aligned_alloc(64, (size + 63) & ~(size_t)63);
+}
+
+MemoryArena::~MemoryArena(){
+	free(currentBlock);
+	for(auto& block : usedBlocks)
+		free(block.second);
+	for(auto& block : availableBlocks)
+		free(block.second);
+}
+
+void* MemoryArena::alloc(size_t nBytes){
+	nBytes = (nBytes + Align - 1) & ~(Align - 1);
+	if(currentBlockPos + nBytes > currentAllocSize){
+		// retire the current block and find one large enough
+		if(currentBlock){
+			usedBlocks.push_back(std::make_pair(currentAllocSize, currentBlock));
+			currentBlock = nullptr;
+			currentAllocSize = 0;
+		}
+		for(auto iter = availableBlocks.begin(); iter != availableBlocks.end(); ++iter){
+			if(iter->first >= nBytes){
+				currentAllocSize = iter->first;
+				currentBlock = iter->second;
+				availableBlocks.erase(iter);
+				break;
+			}
+		}
+		if(!currentBlock){
+			currentAllocSize = std::max(nBytes, blockSize);
+			currentBlock = allocAligned(currentAllocSize);
+			if(!currentBlock)
+				throw("MemoryArena is out of memory!");
+		}
+		currentBlockPos = 0;
+	}
+	void* ret = currentBlock + currentBlockPos;
+	currentBlockPos += nBytes;
+	return ret;
+}
+
+void MemoryArena::reset(){
+	currentBlockPos = 0;
+	availableBlocks.splice(availableBlocks.begin(), usedBlocks);
+}
+
+size_t MemoryArena::totalAllocated() const{
+	size_t total = currentAllocSize;
+	for(const auto& block : usedBlocks)
+		total += block.first;
+	for(const auto& block : availableBlocks)
+		total += block.first;
+	return total;
+}
+
+RIGA_NAMESPACE_END
@@ -20,9 +20,10 @@ bool GeometricPrimitive::intersectP(const Ray& ray) const{
 	return shape->intersectP(ray);
 }
 
-void GeometricPrimitive::computeScatteringFunctions(SurfaceInteraction* isect, TransportMode mode) const{
+void GeometricPrimitive::computeScatteringFunctions(SurfaceInteraction* isect, 
+	MemoryArena& arena, TransportMode mode) const{
 	if(material)
-		material->computeScatteringFunctions(isect, mode);
+		material->computeScatteringFunctions(isect, arena, mode);
 	if(Dot(isect->n, isect->shading.n) < 0)
 		throw("Shaing normal and geometry normal are not in a same hemiSphere!");
 }
@@ -120,11 +120,6 @@ int BSDF::getNumComponents(BxDFType flags) const{
 	return num;
 }
 
-BSDF::~BSDF(){
-	for(size_t i=0; i<nBxDFs; ++i)
-		bxdfs[i]->~BxDF();
-}
-
 Spectrum BSDF::f(const Vec3f& wo_world, const Vec3f& wi_world, 
 	BxDFType flags) const{
 	Vec3f wo = world2Local(wo_world), wi = world2Local(wi_world);
@@ -142,10 +137,12 @@ Spectrum BSDF::f(const Vec3f& wo_world, const Vec3f& wi_world,
 }
 
 Spectrum BSDF::sample_f(const Vec3f& wo_world, Vec3f* wi_world, const Point2f& u, 
-	float *pdf, BxDFType type) const{
+	float *pdf, BxDFType type, BxDFType* sampledType) const{
 	int matchingComps = getNumComponents(type);
 	if(matchingComps == 0){
 		*pdf = 0;
+		if(sampledType)
+			*sampledType = BxDFType(0);
 		return Spectrum(0);
 	}
 	// sample a bxdf to get wi
@@ -157,6 +154,8 @@ Spectrum BSDF::sample_f(const Vec3f& wo_world, Vec3f* wi_world, const Point2f& u
 			bxdf = bxdfs[i];
 			break;
 		}
+	if(sampledType)
+		*sampledType = bxdf->type;
 	// remap a sample
 	Point2f uRemapped(u[0] * matchingComps - comp, u[1]);
 	Vec3f wi, wo = world2Local(wo_world);
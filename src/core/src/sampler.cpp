@@ -1,5 +1,7 @@
 #include <core/sampler.h>
 #include <core/camera.h>
+#include <core/lowdiscrepancy.h>
+#include <core/sampling.h>
 
 RIGA_NAMESPACE_BEGIN
 
@@ -18,21 +20,38 @@ void Sampler::startPixel(const Point2i &p) {
     currentPixelSampleIndex = 0;
     // Reset array offsets for next pixel sample
     array1DOffset = array2DOffset = 0;
+    blueNoiseDimension = 0;
 }
 
 bool Sampler::startNextSample() {
     // Reset array offsets for next pixel sample
     array1DOffset = array2DOffset = 0;
+    blueNoiseDimension = 0;
     return ++currentPixelSampleIndex < samplesPerPixel;
 }
 
 bool Sampler::setSampleNumber(int64_t sampleNum) {
     // Reset array offsets for next pixel sample
     array1DOffset = array2DOffset = 0;
+    blueNoiseDimension = 0;
     currentPixelSampleIndex = sampleNum;
     return currentPixelSampleIndex < samplesPerPixel;
 }
 
+float Sampler::blueNoiseScramble(float u) {
+    // the offsets of the dimensions follow the R2 sequence, which keeps neighbouring
+    // dimensions far apart on the tile
+    const int dim = blueNoiseDimension++;
+    const int x = Mod(currentPixel.x + (int)(std::fmod(dim * 0.7548776662, 1.) * BlueNoiseTileSize),
+                      BlueNoiseTileSize);
+    const int y = Mod(currentPixel.y + (int)(std::fmod(dim * 0.5698402910, 1.) * BlueNoiseTileSize),
+                      BlueNoiseTileSize);
+    // xor of the leading bits is a digital shift, unlike an addition it keeps the base 2
+    // stratification of the pixel's samples
+    const uint32_t shift = BlueNoiseTile()[y * BlueNoiseTileSize + x] * 0x1p24f;
+    return ((uint32_t)(u * 0x1p24f) ^ shift) * 0x1p-24f;
+}
+
 void Sampler::request1DArray(int n) {
     samples1DArraySizes.push_back(n);
     sampleArray1D.push_back(std::vector<float>(n * samplesPerPixel));
@@ -61,6 +80,73 @@ const Point2f *Sampler::get2DArray(int n) {
     return &sampleArray2D[array2DOffset++][currentPixelSampleIndex * n];
 }
 
+// PixelSampler Method Definitions
+PixelSampler::PixelSampler(int64_t samplesPerPixel, int nSampledDimensions, int seed)
+    : Sampler(samplesPerPixel), seed(seed) {
+    for (int i = 0; i < nSampledDimensions; ++i) {
+        samples1D.push_back(std::vector<float>(samplesPerPixel));
+        samples2D.push_back(std::vector<Point2f>(samplesPerPixel));
+    }
+}
+
+uint64_t PixelSampler::pixelHash() const {
+    if (blueNoise) return MixBits((uint64_t)seed << 16);
+    return MixBits(((uint64_t)(uint32_t)currentPixel.x << 32) ^ (uint32_t)currentPixel.y ^
+                   ((uint64_t)seed << 16));
+}
+
+float PixelSampler::nextRandom() {
+    if (!sampleSeeded) {
+        rng.seed(pixelHash(), currentPixelSampleIndex + 1);
+        sampleSeeded = true;
+    }
+    return rng.nextFloat();
+}
+
+void PixelSampler::startPixel(const Point2i &p) {
+    Sampler::startPixel(p);
+    current1DDimension = current2DDimension = 0;
+    // stream 0 is for the tables, the samples use the streams after it
+    rng.seed(pixelHash(), 0);
+    sampleSeeded = false;
+}
+
+bool PixelSampler::startNextSample() {
+    current1DDimension = current2DDimension = 0;
+    sampleSeeded = false;
+    return Sampler::startNextSample();
+}
+
+bool PixelSampler::setSampleNumber(int64_t sampleNum) {
+    current1DDimension = current2DDimension = 0;
+    sampleSeeded = false;
+    return Sampler::setSampleNumber(sampleNum);
+}
+
+float PixelSampler::get1D() {
+    float u;
+    if (current1DDimension < samples1D.size() && currentPixelSampleIndex < samplesPerPixel)
+        u = samples1D[current1DDimension++][currentPixelSampleIndex];
+    else
+        u = nextRandom();
+    return blueNoise ? blueNoiseScramble(u) : u;
+}
+
+Point2f PixelSampler::get2D() {
+    Point2f u;
+    if (current2DDimension < samples2D.size() && currentPixelSampleIndex < samplesPerPixel)
+        u = samples2D[current2DDimension++][currentPixelSampleIndex];
+    else {
+        u.x = nextRandom();
+        u.y = nextRandom();
+    }
+    if (blueNoise) {
+        u.x = blueNoiseScramble(u.x);
+        u.y = blueNoiseScramble(u.y);
+    }
+    return u;
+}
+
 void GlobalSampler::startPixel(const Point2i &p) {
     Sampler::startPixel(p);
     dimension = 0;
@@ -108,7 +194,8 @@ bool GlobalSampler::setSampleNumber(int64_t sampleNum) {
 float GlobalSampler::get1D() {
     if (dimension >= arrayStartDim && dimension < arrayEndDim)
         dimension = arrayEndDim;
-    return sampleDimension(intervalSampleIndex, dimension++);
+    float u = sampleDimension(intervalSampleIndex, dimension++);
+    return blueNoise ? blueNoiseScramble(u) : u;
 }
 
 Point2f GlobalSampler::get2D() {
@@ -117,6 +204,10 @@ Point2f GlobalSampler::get2D() {
     Point2f p(sampleDimension(intervalSampleIndex, dimension),
               sampleDimension(intervalSampleIndex, dimension + 1));
     dimension += 2;
+    if (blueNoise) {
+        p.x = blueNoiseScramble(p.x);
+        p.y = blueNoiseScramble(p.y);
+    }
     return p;
 }
 
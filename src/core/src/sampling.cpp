@@ -0,0 +1,187 @@
+#include <core/sampling.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// Sampling Function Definitions
+void StratifiedSample1D(float *samp, int nSamples, pcg32 &rng, bool jitter) {
+    float invNSamples = (float)1 / nSamples;
+    for (int i = 0; i < nSamples; ++i) {
+        float delta = jitter ? rng.nextFloat() : 0.5f;
+        samp[i] = std::min((i + delta) * invNSamples, OneMinusEpsilon);
+    }
+}
+
+void StratifiedSample2D(Point2f *samp, int nx, int ny, pcg32 &rng, bool jitter) {
+    float dx = (float)1 / nx, dy = (float)1 / ny;
+    for (int y = 0; y < ny; ++y)
+        for (int x = 0; x < nx; ++x) {
+            float jx = jitter ? rng.nextFloat() : 0.5f;
+            float jy = jitter ? rng.nextFloat() : 0.5f;
+            samp->x = std::min((x + jx) * dx, OneMinusEpsilon);
+            samp->y = std::min((y + jy) * dy, OneMinusEpsilon);
+            ++samp;
+        }
+}
+
+void LatinHypercube(float *samples, int nSamples, int nDim, pcg32 &rng) {
+    // Generate LHS samples along diagonal
+    float invNSamples = (float)1 / nSamples;
+    for (int i = 0; i < nSamples; ++i)
+        for (int j = 0; j < nDim; ++j) {
+            float sj = (i + (rng.nextFloat())) * invNSamples;
+            samples[nDim * i + j] = std::min(sj, OneMinusEpsilon);
+        }
+
+    // Permute LHS samples in each dimension
+    for (int i = 0; i < nDim; ++i) {
+        for (int j = 0; j < nSamples; ++j) {
+            int other = j + rng.nextUInt(nSamples - j);
+            std::swap(samples[nDim * j + i], samples[nDim * other + i]);
+        }
+    }
+}
+
+// Ulichney's void and cluster method : the energy of a pixel is the gaussian weighted
+// count of the set pixels around it on the torus, the tightest cluster is the set pixel
+// with the highest energy and the largest void the empty one with the lowest
+static std::vector<float> computeBlueNoiseTile() {
+    const int size = BlueNoiseTileSize, n = size * size;
+    const float sigma = 1.5f;
+    std::vector<float> kernel(n);
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x) {
+            int dx = std::min(x, size - x), dy = std::min(y, size - y);
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
+        }
+
+    auto update = [&](std::vector<float> &energy, int p, float sign) {
+        const int px = p % size, py = p / size;
+        for (int y = 0; y < size; ++y) {
+            const float *k = &kernel[((y - py + size) % size) * size];
+            for (int x = 0; x < size; ++x)
+                energy[y * size + x] += sign * k[(x - px + size) % size];
+        }
+    };
+    auto tightestCluster = [&](const std::vector<float> &energy, const std::vector<bool> &set) {
+        int best = -1;
+        for (int p = 0; p < n; ++p)
+            if (set[p] && (best < 0 || energy[p] > energy[best])) best = p;
+        return best;
+    };
+    auto largestVoid = [&](const std::vector<float> &energy, const std::vector<bool> &set) {
+        int best = -1;
+        for (int p = 0; p < n; ++p)
+            if (!set[p] && (best < 0 || energy[p] < energy[best])) best = p;
+        return best;
+    };
+
+    // random initial pattern of a tenth of the pixels, relaxed by moving the tightest
+    // cluster into the largest void until it lands where it came from
+    pcg32 rng;
+    std::vector<bool> initialSet(n, false);
+    std::vector<float> initialEnergy(n, 0.f);
+    const int nInitial = n / 10;
+    for (int i = 0; i < nInitial; ++i) {
+        int p;
+        do p = rng.nextUInt(n);
+        while (initialSet[p]);
+        initialSet[p] = true;
+        update(initialEnergy, p, 1.f);
+    }
+    for (;;) {
+        int cluster = tightestCluster(initialEnergy, initialSet);
+        initialSet[cluster] = false;
+        update(initialEnergy, cluster, -1.f);
+        int largest = largestVoid(initialEnergy, initialSet);
+        initialSet[largest] = true;
+        update(initialEnergy, largest, 1.f);
+        if (largest == cluster) break;
+    }
+
+    // rank the initial pixels by removing tightest clusters, then the remaining ones
+    // by filling the largest voids
+    std::vector<int> rank(n);
+    std::vector<bool> set = initialSet;
+    std::vector<float> energy = initialEnergy;
+    for (int r = nInitial - 1; r >= 0; --r) {
+        int cluster = tightestCluster(energy, set);
+        set[cluster] = false;
+        update(energy, cluster, -1.f);
+        rank[cluster] = r;
+    }
+    set = initialSet;
+    energy = initialEnergy;
+    for (int r = nInitial; r < n; ++r) {
+        int largest = largestVoid(energy, set);
+        set[largest] = true;
+        update(energy, largest, 1.f);
+        rank[largest] = r;
+    }
+
+    std::vector<float> tile(n);
+    for (int p = 0; p < n; ++p) tile[p] = (rank[p] + 0.5f) / n;
+    return tile;
+}
+
+const float *BlueNoiseTile() {
+    static const std::vector<float> tile = computeBlueNoiseTile();
+    return tile.data();
+}
+
+AliasTable::AliasTable(const std::vector<float> &weights) : bins(weights.size()) {
+    double sum = 0;
+    for (float w : weights) sum += std::max(0.f, w);
+    if (sum == 0) {
+        for (Bin &bin : bins) bin = Bin{0.f, 0.f, -1};
+        return;
+    }
+    for (size_t i = 0; i < weights.size(); ++i)
+        bins[i] = Bin{0.f, float(std::max(0.f, weights[i]) / sum), -1};
+
+    // bins whose scaled probability is below one are filled up by the ones above it
+    struct Outcome {
+        float pHat;
+        int index;
+    };
+    std::vector<Outcome> under, over;
+    for (size_t i = 0; i < bins.size(); ++i) {
+        const float pHat = bins[i].p * bins.size();
+        (pHat < 1 ? under : over).push_back(Outcome{pHat, int(i)});
+    }
+    while (!under.empty() && !over.empty()) {
+        const Outcome un = under.back(), ov = over.back();
+        under.pop_back();
+        over.pop_back();
+        bins[un.index].q = un.pHat;
+        bins[un.index].alias = ov.index;
+        const float pExcess = un.pHat + ov.pHat - 1;
+        (pExcess < 1 ? under : over).push_back(Outcome{pExcess, ov.index});
+    }
+    // what is left is one up to rounding
+    while (!over.empty()) {
+        bins[over.back().index].q = 1;
+        over.pop_back();
+    }
+    while (!under.empty()) {
+        bins[under.back().index].q = 1;
+        under.pop_back();
+    }
+}
+
+int AliasTable::sample(float u, float *pmf, float *uRemapped) const {
+    if (bins.empty() || (bins[0].q == 0 && bins[0].alias == -1)) return -1;
+    const int offset = std::min<int>(u * bins.size(), bins.size() - 1);
+    const float up = std::min<float>(u * bins.size() - offset, OneMinusEpsilon);
+    if (up < bins[offset].q) {
+        if (pmf) *pmf = bins[offset].p;
+        if (uRemapped) *uRemapped = std::min(up / bins[offset].q, OneMinusEpsilon);
+        return offset;
+    }
+    const int alias = bins[offset].alias;
+    if (pmf) *pmf = bins[alias].p;
+    if (uRemapped)
+        *uRemapped = std::min((up - bins[offset].q) / (1 - bins[offset].q), OneMinusEpsilon);
+    return alias;
+}
+
+RIGA_NAMESPACE_END
@@ -6,8 +6,25 @@ bool Scene::intersect(const Ray& ray, SurfaceInteraction* isect) const{
 	return agg->intersect(ray, isect);
 }
 
+std::atomic<uint64_t> Scene::nextId(1);
+
 bool Scene::intersectP(const Ray& ray) const{
-	return agg->intersectP(ray);
+	// neighbouring shadow rays of a thread are often blocked by the same primitive,
+	// so the last occluder is tested before traversing the aggregate
+	struct OccluderCache{
+		uint64_t sceneId = 0;
+		const Primitive* occluder = nullptr;
+	};
+	thread_local OccluderCache cache;
+	if(cache.sceneId == id && cache.occluder != nullptr && cache.occluder->intersectP(ray))
+		return true;
+
+	const Primitive* occluder = nullptr;
+	if(!agg->intersectP(ray, &occluder))
+		return false;
+	cache.sceneId = id;
+	cache.occluder = occluder;
+	return true;
 }
 
 RIGA_NAMESPACE_END
\ No newline at end of file
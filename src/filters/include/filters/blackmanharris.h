@@ -0,0 +1,18 @@
+#pragma once
+
+#include <core/filter.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// 4 term Blackman-Harris window stretched over [-radius, radius]
+class BlackmanHarrisFilter : public Filter{
+public:
+	BlackmanHarrisFilter(const Vec2f& radius = Vec2f(2.f, 2.f)) : Filter(radius){}
+	float evaluate(const Point2f& p) const;
+
+private:
+	// t in [0, 1]
+	static float window(float t);
+};
+
+RIGA_NAMESPACE_END
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <core/filter.h>
+
+RIGA_NAMESPACE_BEGIN
+
+class BoxFilter : public Filter{
+public:
+	BoxFilter(const Vec2f& radius = Vec2f(0.5f, 0.5f)) : Filter(radius){}
+	float evaluate(const Point2f& p) const;
+};
+
+RIGA_NAMESPACE_END
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <core/filter.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// gaussian of falloff alpha, shifted down so that it reaches zero at the radius
+class GaussianFilter : public Filter{
+public:
+	GaussianFilter(const Vec2f& radius = Vec2f(1.5f, 1.5f), float alpha = 2.f)
+	: Filter(radius), alpha(alpha), 
+	  expX(std::exp(-alpha * radius.x * radius.x)), 
+	  expY(std::exp(-alpha * radius.y * radius.y)){}
+	float evaluate(const Point2f& p) const;
+
+private:
+	float gaussian(float d, float expv) const{
+		return std::max(0.f, std::exp(-alpha * d * d) - expv);
+	}
+
+	const float alpha;
+	const float expX, expY;
+};
+
+RIGA_NAMESPACE_END
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <core/filter.h>
+
+RIGA_NAMESPACE_BEGIN
+
+// Mitchell-Netravali cubic, B = C = 1/3 trades ringing against blurring
+class MitchellFilter : public Filter{
+public:
+	MitchellFilter(const Vec2f& radius = Vec2f(2.f, 2.f), float B = 1.f / 3.f, float C = 1.f / 3.f)
+	: Filter(radius), B(B), C(C){}
+	float evaluate(const Point2f& p) const;
+
+private:
+	// x in [-2, 2]
+	float mitchell1D(float x) const;
+
+	const float B, C;
+};
+
+RIGA_NAMESPACE_END
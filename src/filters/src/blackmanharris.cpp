@@ -0,0 +1,16 @@
+#include <filters/blackmanharris.h>
+
+RIGA_NAMESPACE_BEGIN
+
+float BlackmanHarrisFilter::evaluate(const Point2f& p) const{
+	return window(0.5f * (p.x * invRadius.x + 1.f)) * window(0.5f * (p.y * invRadius.y + 1.f));
+}
+
+float BlackmanHarrisFilter::window(float t){
+	if(t < 0.f || t > 1.f)
+		return 0.f;
+	const float a0 = 0.35875f, a1 = 0.48829f, a2 = 0.14128f, a3 = 0.01168f;
+	return a0 - a1 * std::cos(2 * PI * t) + a2 * std::cos(4 * PI * t) - a3 * std::cos(6 * PI * t);
+}
+
+RIGA_NAMESPACE_END
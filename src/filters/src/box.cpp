@@ -0,0 +1,9 @@
+#include <filters/box.h>
+
+RIGA_NAMESPACE_BEGIN
+
+float BoxFilter::evaluate(const Point2f& p) const{
+	return 1.f;
+}
+
+RIGA_NAMESPACE_END
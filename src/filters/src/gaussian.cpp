@@ -0,0 +1,9 @@
+#include <filters/gaussian.h>
+
+RIGA_NAMESPACE_BEGIN
+
+float GaussianFilter::evaluate(const Point2f& p) const{
+	return gaussian(p.x, expX) * gaussian(p.y, expY);
+}
+
+RIGA_NAMESPACE_END
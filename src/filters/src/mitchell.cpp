@@ -0,0 +1,20 @@
+#include <filters/mitchell.h>
+
+RIGA_NAMESPACE_BEGIN
+
+float MitchellFilter::evaluate(const Point2f& p) const{
+	return mitchell1D(2.f * p.x * invRadius.x) * mitchell1D(2.f * p.y * invRadius.y);
+}
+
+float MitchellFilter::mitchell1D(float x) const{
+	x = std::abs(x);
+	if(x > 2.f)
+		return 0.f;
+	if(x > 1.f)
+		return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x +
+				(-12 * B - 48 * C) * x + (8 * B + 24 * C)) * (1.f / 6.f);
+	return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x +
+			(6 - 2 * B)) * (1.f / 6.f);
+}
+
+RIGA_NAMESPACE_END
@@ -4,15 +4,34 @@
 #include <core/integrator.h>
 
 RIGA_NAMESPACE_BEGIN
+// unidirectional path tracer. every non specular vertex samples a light (next event estimation)
+// and the bsdf, the two are combined by multiple importance sampling with the power heuristic.
+// paths end after maxDepth bounces or by russian roulette once the throughput falls below
+// rrThreshold
 class PathIntegrator : public SamplerIntegrator
 {
 public:
-    PathIntegrator(int maxDepth, std::shared_ptr<const Camera> cam, std::shared_ptr<Sampler> samp)
-        : SamplerIntegrator(cam, samp), maxDepth(maxDepth){}
-    Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler, int depth = 0) const;
+    PathIntegrator(int maxDepth, std::shared_ptr<const Camera> cam, std::shared_ptr<Sampler> samp,
+        float rrThreshold = 1.f)
+        : SamplerIntegrator(cam, samp), maxDepth(maxDepth), rrThreshold(rrThreshold){}
+    Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler, 
+        MemoryArena& arena, int depth = 0) const;
+
+    // bounces before russian roulette may end a path
+    static constexpr int MinRRDepth = 3;
 
 private:
+    // the light arriving at isect from a sample of light, which was picked with probability
+    // lightPmf, weighted against bsdf sampling
+    Spectrum sampleLd(const SurfaceInteraction& isect, const Scene& scene, Sampler& sampler,
+        const Light& light, float lightPmf) const;
+    // the probability that next event estimation picks light at ref
+    float lightPmf(const Interaction& ref, const Light* light) const{
+        return lightDistribution ? lightDistribution->pmf(ref, light) : 1.f;
+    }
+
     const int maxDepth;
+    const float rrThreshold;
 };
 
-RIGA_NAMESPACE_END
\ No newline at end of file
+RIGA_NAMESPACE_END
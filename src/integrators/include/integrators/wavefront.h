@@ -0,0 +1,120 @@
+#pragma once
+
+#include <core/common.h>
+#include <core/integrator.h>
+#include <core/interaction.h>
+#include <core/light.h>
+#include <core/memory.h>
+#include <pcg32/pcg32.h>
+#include <integrators/path.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <atomic>
+
+RIGA_NAMESPACE_BEGIN
+
+// wavefront path tracer : rather than following one path at a time, the paths of a band of
+// tiles (a wave) are advanced together one stage at a time, each stage a parallel loop over
+// a queue. camera rays are generated, the queued rays are intersected, the hits are shaded
+// material by material (a light sample and a bsdf sample each), the shadow rays are traced
+// and the bounced rays form the next queue, until no path is left. the samples are then
+// splatted to the film tile by tile. the estimate is the one of PathIntegrator except that
+// every vertex takes one light sample : from the light distribution when one is set, else a
+// light chosen uniformly
+class WavefrontPathIntegrator : public Integrator{
+public:
+	// a wave holds about maxQueueSize paths
+	WavefrontPathIntegrator(int maxDepth, std::shared_ptr<const Camera> cam,
+		std::shared_ptr<Sampler> samp, float rrThreshold = 1.f, int maxQueueSize = 1 << 18);
+	void render(const Scene& scene);
+	// see SamplerIntegrator::setLightDistribution
+	void setLightDistribution(const std::string& name);
+
+	static constexpr int TileSize = SamplerIntegrator::TileSize;
+	// sampler dimensions of a bounce : the light (1D), a point on it (2D), the bsdf (2D) and
+	// russian roulette (1D), drawn in this order
+	static constexpr int SamplesPerBounce = 6;
+	// the paths of a wave are not at their pixel in the sampler anymore once they bounce, the
+	// values of the first SampledBounces bounces are drawn along with the camera ray and kept.
+	// deeper bounces take uniform random numbers from a stream of the path, as the pixel
+	// samplers do past their dimensions, so no time goes to values a path never reaches
+	static constexpr int SampledBounces = 2;
+
+private:
+	struct PathState{
+		Spectrum L, throughput;
+		CameraSample cameraSample;
+		float rayWeight;
+		// the vertex the last bounce left and its bsdf pdf, for the mis weight of the emission
+		// the bounce hits
+		Point3f prevP;
+		Normal3f prevN;
+		float pdf_bsdf;
+		float etaScale;
+		bool specularBounce;
+		// seeded from the pixel and the sample number
+		pcg32 rng;
+	};
+	struct RayItem{
+		Ray ray;
+		int pathIndex;
+	};
+	// a hit waiting for its material, index is the one in the ray queue
+	struct ShadeItem{
+		const Material* material;
+		int index;
+	};
+	struct ShadowItem{
+		VisibilityTester vis;
+		Spectrum Ld;
+		int pathIndex;
+	};
+	// fixed size queue, items are pushed from parallel loops
+	template <typename T>
+	struct Queue{
+		void reset(size_t capacity){
+			items.resize(capacity);
+			count = 0;
+		}
+		void push(const T& item){
+			items[count++] = item;
+		}
+		int size() const{
+			return count;
+		}
+
+		std::vector<T> items;
+		std::atomic<int> count{0};
+	};
+
+	// the paths of tile rows [tileRowBegin, tileRowEnd) and samples [sampleBegin, sampleEnd)
+	void renderWave(const Scene& scene, int tileRowBegin, int tileRowEnd, int64_t sampleBegin,
+		int64_t sampleEnd);
+	// the probability that the light sample of a vertex at ref picks light
+	float lightPmf(const Interaction& ref, const Light* light, const Scene& scene) const;
+
+	std::shared_ptr<const Camera> camera;
+	std::shared_ptr<Sampler> sampler;
+	const int maxDepth;
+	const float rrThreshold;
+	const int maxQueueSize;
+	std::string lightDistributionName;
+	std::unique_ptr<LightDistribution> lightDistribution;
+	// per thread, a sampler clone only needs startPixel to move to another pixel
+	tbb::enumerable_thread_specific<MemoryArena> arenas;
+	tbb::enumerable_thread_specific<std::unique_ptr<Sampler>> samplers;
+
+	// the state of the current wave, kept between waves so the memory is reused. path i of
+	// the wave has the sampler values of its first bounces at samples[i * samplesPerPath]
+	std::vector<PathState> paths;
+	std::vector<float> samples;
+	Queue<RayItem> rayQueue, nextRayQueue;
+	std::vector<SurfaceInteraction> hits;
+	Queue<ShadeItem> shadeQueue;
+	// the shade queue grouped by material, and the index in materials of every item
+	std::vector<ShadeItem> sortedShade;
+	std::vector<int> shadeBuckets;
+	std::vector<const Material*> materials;
+	Queue<ShadowItem> shadowQueue;
+};
+
+RIGA_NAMESPACE_END
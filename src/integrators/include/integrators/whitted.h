@@ -9,7 +9,8 @@ class WhittedIntegrator : public SamplerIntegrator{
 public:
 	WhittedIntegrator(int maxDepth, std::shared_ptr<const Camera> cam, std::shared_ptr<Sampler> samp)
 		: SamplerIntegrator(cam, samp), maxDepth(maxDepth){}
-	Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler, int depth = 0) const;
+	Spectrum Li(const Ray& ray, const Scene& scene, Sampler& sampler, 
+		MemoryArena& arena, int depth = 0) const;
 private:
 	const int maxDepth;
 };
@@ -1,55 +1,111 @@
 #include <integrators/path.h>
 #include <core/scene.h>
 #include <core/sampler.h>
+#include <core/sampling.h>
 #include <core/light.h>
+#include <core/primitive.h>
 
 RIGA_NAMESPACE_BEGIN
 
-Spectrum PathIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& sampler, int depth = 0) const{
+static inline bool IsDeltaLight(LightFlags flags){
+    return (int)flags & ((int)LightFlags::DeltaPosition | (int)LightFlags::DeltaDirection);
+}
+
+Spectrum PathIntegrator::Li(const Ray& r, const Scene& scene, Sampler& sampler, 
+    MemoryArena& arena, int depth) const{
     Spectrum L(0.f), throughput(1.f);
-    float pdf_light = 0.f, pdf_bsdf = 0.f;
-    for(unsigned bounce = 0; bounce < maxDepth; ++bounce){
+    Ray ray(r);
+    bool specularBounce = false;
+    // the bsdf pdf of the last bounce and the vertex it left, for the weight of emission it hits
+    float pdf_bsdf = 0.f;
+    Interaction prevIsect;
+    // refraction scales radiance by eta^2, russian roulette leaves it out
+    float etaScale = 1.f;
+    for(int bounce = 0; ; ++bounce){
         SurfaceInteraction isect;
         bool hasIntersection = scene.intersect(ray, &isect);
-        
-        if(bounce == 0){
-            if(hasIntersection)
-                L += throughput * isect.Le(-ray.dir);
-            // TODO : add infinite area Light
-        }
 
-        if(!hasIntersection)
-            break;        
-        
-        isect.computeScatteringFunctions(ray);
-        
-        // direct
-        for(const auto &light : scene.lights){
-            Vec3f wi;
-            pdf_light = 0.f;
-            VisibilityTester vis;
-            Spectrum L_light = light->sample_Li(isect, sampler.get2D(), &wi, &pdf_light, &vis);
-            if(L_light.isBlack() || pdf_light == 0.f)
-                continue;
-            if(vis.unoccluded(scene)){
-                pdf_bsdf = isect.bsdf->pdf(isect.wo, wi);
-                if(pdf_bsdf != 0.f && pdf_light != 0.f){
-                    float mis_pdf = pdf_light / (pdf_bsdf + pdf_light);
-                    Spectrum L_direct = throughput * L_light;
-                    L += L_direct;
+        // emission : camera rays and specular bounces take it as is, other bounces weigh it
+        // against the light sample of the vertex they left
+        if(hasIntersection){
+            Spectrum Le = isect.Le(-ray.dir);
+            if(!Le.isBlack()){
+                if(bounce == 0 || specularBounce)
+                    L += throughput * Le;
+                else{
+                    const AreaLight* light = isect.primitive->getAreaLight();
+                    float pdf_light = lightPmf(prevIsect, light) * light->pdf_Li(prevIsect, ray.dir);
+                    L += throughput * Le * PowerHeuristic(1, pdf_bsdf, 1, pdf_light);
                 }
             }
         }
+        // TODO : add infinite area Light
+
+        if(!hasIntersection || bounce >= maxDepth)
+            break;
+
+        isect.computeScatteringFunctions(ray, arena);
+
+        // direct, nothing to do on perfectly specular surfaces
+        if(isect.bsdf->getNumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0){
+            if(lightDistribution){
+                float pmf = 0.f;
+                const Light* light = lightDistribution->sample(isect, sampler.get1D(), &pmf);
+                if(light)
+                    L += throughput * sampleLd(isect, scene, sampler, *light, pmf);
+            }else{
+                for(const auto &light : scene.lights)
+                    L += throughput * sampleLd(isect, scene, sampler, *light, 1.f);
+            }
+        }
 
         // indirect
         Vec3f wo = isect.wo, wi;
         Vec3f normal = Normalize(Vec3f(isect.shading.n));
         pdf_bsdf = 0.f;
-        Spectrum f = isect.bsdf->sample_f(wo, &wi, sampler.get2D(), &pdf_bsdf);
+        BxDFType sampledType;
+        Spectrum f = isect.bsdf->sample_f(wo, &wi, sampler.get2D(), &pdf_bsdf, BSDF_ALL, &sampledType);
         if(f.isBlack() || pdf_bsdf == 0.f)
             break;
-        throughput *= f * AbsDot(wi, normal);
+        throughput *= f * AbsDot(wi, normal) / pdf_bsdf;
+        specularBounce = (sampledType & BSDF_SPECULAR) != 0;
+        if((sampledType & BSDF_SPECULAR) && (sampledType & BSDF_TRANSMISSION)){
+            float eta = isect.bsdf->eta;
+            etaScale *= Dot(wo, Vec3f(isect.n)) > 0.f ? eta * eta : 1.f / (eta * eta);
+        }
+        prevIsect = isect;
+        ray = isect.spawnRay(wi);
+
+        // russian roulette, paths that carry little are ended with probability q and the
+        // survivors weighted up by 1 / (1 - q)
+        Spectrum rrThroughput = throughput * etaScale;
+        if(bounce >= MinRRDepth && rrThroughput.maxComponentValue() < rrThreshold){
+            float q = std::max(0.05f, 1.f - rrThroughput.maxComponentValue());
+            if(sampler.get1D() < q)
+                break;
+            throughput /= 1.f - q;
+        }
     }
+    return L;
+}
+
+Spectrum PathIntegrator::sampleLd(const SurfaceInteraction& isect, const Scene& scene, 
+    Sampler& sampler, const Light& light, float lightPmf) const{
+    Vec3f wi;
+    float pdf_light = 0.f;
+    VisibilityTester vis;
+    Spectrum L_light = light.sample_Li(isect, sampler.get2D(), &wi, &pdf_light, &vis);
+    if(L_light.isBlack() || pdf_light == 0.f)
+        return Spectrum(0.f);
+    Spectrum f = isect.bsdf->f(isect.wo, wi) * AbsDot(wi, Normalize(Vec3f(isect.shading.n)));
+    if(f.isBlack() || !vis.unoccluded(scene))
+        return Spectrum(0.f);
+    pdf_light *= lightPmf;
+    // bsdf samples never hit a delta light
+    if(IsDeltaLight(light.flags))
+        return f * L_light / pdf_light;
+    float pdf_bsdf = isect.bsdf->pdf(isect.wo, wi);
+    return f * L_light * PowerHeuristic(1, pdf_light, 1, pdf_bsdf) / pdf_light;
 }
 
-RIGA_NAMESPACE_END
\ No newline at end of file
+RIGA_NAMESPACE_END
@@ -0,0 +1,301 @@
+#include <integrators/wavefront.h>
+#include <core/scene.h>
+#include <core/sampler.h>
+#include <core/sampling.h>
+#include <core/lowdiscrepancy.h>
+#include <core/primitive.h>
+#include <core/reflection.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+#include <tbb/tick_count.h>
+#include <algorithm>
+
+RIGA_NAMESPACE_BEGIN
+
+WavefrontPathIntegrator::WavefrontPathIntegrator(int maxDepth, std::shared_ptr<const Camera> cam,
+	std::shared_ptr<Sampler> samp, float rrThreshold, int maxQueueSize)
+	: camera(cam), sampler(samp), maxDepth(std::max(0, maxDepth)), rrThreshold(rrThreshold),
+	  maxQueueSize(std::max(1, maxQueueSize)), samplers([this](){
+		return sampler->clone(tbb::this_task_arena::current_thread_index());
+	  }){
+}
+
+void WavefrontPathIntegrator::setLightDistribution(const std::string& name){
+	lightDistributionName = name;
+}
+
+float WavefrontPathIntegrator::lightPmf(const Interaction& ref, const Light* light, 
+	const Scene& scene) const{
+	if(lightDistribution)
+		return lightDistribution->pmf(ref, light);
+	return scene.lights.empty() ? 0.f : 1.f / scene.lights.size();
+}
+
+void WavefrontPathIntegrator::render(const Scene& scene){
+	Film* film = camera->film;
+	if(film->hasAOVs())
+		throw("The wavefront integrator does not record the AOVs of the denoiser!");
+	const Point2i resolution = film->fullResolution;
+	film->clear();
+	lightDistribution = CreateLightDistribution(lightDistributionName, scene);
+
+	// waves of whole tile rows : as many samples of a tile row as fit in a wave, then as many
+	// tile rows as fit. a streaming film takes one tile row at a time
+	const Point2i nTiles((resolution.x + TileSize - 1) / TileSize,
+						 (resolution.y + TileSize - 1) / TileSize);
+	const int64_t rowSlots = (int64_t)nTiles.x * TileSize * TileSize;
+	const int64_t spp = sampler->samplesPerPixel;
+	const int64_t samplesPerWave = std::min(std::max<int64_t>(maxQueueSize / rowSlots, 1), spp);
+	const int rowsPerWave = film->isStreaming() ? 1 :
+		std::min<int64_t>(std::max<int64_t>(maxQueueSize / (rowSlots * samplesPerWave), 1), nTiles.y);
+
+	TICK_TBB(RENDER)
+	for(int ty=0; ty<nTiles.y; ty+=rowsPerWave){
+		const int tyEnd = std::min(ty + rowsPerWave, nTiles.y);
+		for(int64_t s=0; s<spp; s+=samplesPerWave)
+			renderWave(scene, ty, tyEnd, s, std::min(s + samplesPerWave, spp));
+		if(film->isStreaming())
+			film->finishRows(std::min(tyEnd * TileSize, resolution.y));
+	}
+	TOCK_TBB(RENDER)
+	if(!film->isStreaming())
+		film->writeImage();
+}
+
+void WavefrontPathIntegrator::renderWave(const Scene& scene, int tileRowBegin, int tileRowEnd,
+	int64_t sampleBegin, int64_t sampleEnd){
+	Film* film = camera->film;
+	const Point2i resolution = film->fullResolution;
+	const int nTilesX = (resolution.x + TileSize - 1) / TileSize;
+	const int nTiles = (tileRowEnd - tileRowBegin) * nTilesX;
+	const int nSamples = sampleEnd - sampleBegin;
+	// path (tile * TileSize^2 + pixel of the tile) * nSamples + sample. the slots of the
+	// pixels a tile at the border of the image does not have stay unused
+	const int pathsPerTile = TileSize * TileSize * nSamples;
+	const int nPaths = nTiles * pathsPerTile;
+	const int sampledBounces = std::min(maxDepth, SampledBounces);
+	const int samplesPerPath = SamplesPerBounce * sampledBounces;
+	auto tileBounds = [&](int tile){
+		const Point2i tileMin((tile % nTilesX) * TileSize, (tileRowBegin + tile / nTilesX) * TileSize);
+		return Bounds2i(tileMin, Point2i(std::min(tileMin.x + TileSize, resolution.x),
+										 std::min(tileMin.y + TileSize, resolution.y)));
+	};
+
+	if((int)paths.size() < nPaths){
+		paths.resize(nPaths);
+		samples.resize((size_t)nPaths * samplesPerPath);
+		hits.resize(nPaths);
+	}
+	rayQueue.reset(nPaths);
+	nextRayQueue.reset(nPaths);
+	shadeQueue.reset(nPaths);
+	shadowQueue.reset(nPaths);
+	sortedShade.resize(nPaths);
+	shadeBuckets.resize(nPaths);
+
+	// camera rays, and the sampler values of the first bounces while the sampler is at the pixel
+	tbb::parallel_for(0, nTiles, [&](int tile){
+		Sampler& tileSampler = *samplers.local();
+		const Bounds2i bounds = tileBounds(tile);
+		for(int y=bounds.pMin.y; y<bounds.pMax.y; ++y)
+			for(int x=bounds.pMin.x; x<bounds.pMax.x; ++x){
+				const Point2i pixel(x, y);
+				tileSampler.startPixel(pixel);
+				const int pathBase = tile * pathsPerTile +
+					((y - bounds.pMin.y) * TileSize + x - bounds.pMin.x) * nSamples;
+				for(int s=0; s<nSamples; ++s){
+					const int pathIndex = pathBase + s;
+					tileSampler.setSampleNumber(sampleBegin + s);
+					PathState& path = paths[pathIndex];
+					path.cameraSample = tileSampler.getCameraSample(pixel);
+					float* u = &samples[(size_t)pathIndex * samplesPerPath];
+					for(int bounce=0; bounce<sampledBounces; ++bounce, u+=SamplesPerBounce){
+						u[0] = tileSampler.get1D();
+						const Point2f uLight = tileSampler.get2D(), uBSDF = tileSampler.get2D();
+						u[1] = uLight.x;
+						u[2] = uLight.y;
+						u[3] = uBSDF.x;
+						u[4] = uBSDF.y;
+						u[5] = tileSampler.get1D();
+					}
+					Ray ray;
+					path.rayWeight = camera->generateRay(path.cameraSample, &ray);
+					path.L = Spectrum(0.f);
+					path.throughput = Spectrum(1.f);
+					path.pdf_bsdf = 0.f;
+					path.etaScale = 1.f;
+					path.specularBounce = false;
+					path.rng.seed(MixBits(((uint64_t)(uint32_t)x << 32) ^ (uint32_t)y), sampleBegin + s);
+					rayQueue.push(RayItem{ray, pathIndex});
+				}
+			}
+	});
+
+	for(int depth=0; rayQueue.size() > 0; ++depth){
+		// intersection. emission is added right away, hits that go on wait for their material
+		tbb::parallel_for(0, rayQueue.size(), [&](int i){
+			const RayItem& item = rayQueue.items[i];
+			PathState& path = paths[item.pathIndex];
+			// a hit overwrites all of it
+			SurfaceInteraction& isect = hits[i];
+			if(!scene.intersect(item.ray, &isect))
+				return;
+			// TODO : add infinite area Light
+			const Spectrum Le = isect.Le(-item.ray.dir);
+			if(!Le.isBlack()){
+				if(depth == 0 || path.specularBounce)
+					path.L += path.throughput * Le;
+				else{
+					// weighed against the light sample of the vertex the bounce left
+					const Interaction prevIsect(path.prevP, path.prevN, Vec3f(), item.ray.time);
+					const AreaLight* light = isect.primitive->getAreaLight();
+					const float pdf_light = lightPmf(prevIsect, light, scene) *
+						light->pdf_Li(prevIsect, item.ray.dir);
+					path.L += path.throughput * Le * PowerHeuristic(1, path.pdf_bsdf, 1, pdf_light);
+				}
+			}
+			if(depth < maxDepth)
+				shadeQueue.push(ShadeItem{isect.primitive->getMaterial(), i});
+		});
+
+		// the hits are grouped by material with a counting sort, scenes have few materials.
+		// within a material they keep the order of the ray queue
+		const int nShade = shadeQueue.size();
+		materials.clear();
+		int bucket = -1;
+		for(int i=0; i<nShade; ++i){
+			const Material* material = shadeQueue.items[i].material;
+			if(bucket < 0 || materials[bucket] != material){
+				bucket = std::find(materials.begin(), materials.end(), material) - materials.begin();
+				if(bucket == (int)materials.size())
+					materials.push_back(material);
+			}
+			shadeBuckets[i] = bucket;
+		}
+		std::vector<int> runBegin(materials.size() + 1, 0);
+		for(int i=0; i<nShade; ++i)
+			++runBegin[shadeBuckets[i] + 1];
+		for(size_t m=0; m<materials.size(); ++m)
+			runBegin[m + 1] += runBegin[m];
+		{
+			std::vector<int> next(runBegin.begin(), runBegin.end() - 1);
+			for(int i=0; i<nShade; ++i)
+				sortedShade[next[shadeBuckets[i]]++] = shadeQueue.items[i];
+		}
+
+		// shading, one material after the other. every hit takes a light sample, which goes to
+		// the shadow ray queue, and a bsdf sample, which continues the path
+		for(size_t m=0; m<materials.size(); ++m){
+			tbb::parallel_for(runBegin[m], runBegin[m + 1], [&](int k){
+				const ShadeItem& shade = sortedShade[k];
+				const RayItem& item = rayQueue.items[shade.index];
+				PathState& path = paths[item.pathIndex];
+				SurfaceInteraction& isect = hits[shade.index];
+				isect.computeScatteringFunctions(item.ray, arenas.local());
+				if(!isect.bsdf)
+					return;
+				float uRandom[SamplesPerBounce];
+				const float* u = uRandom;
+				if(depth < sampledBounces)
+					u = &samples[(size_t)item.pathIndex * samplesPerPath + depth * SamplesPerBounce];
+				else
+					for(int k=0; k<SamplesPerBounce; ++k)
+						uRandom[k] = path.rng.nextFloat();
+				const Vec3f wo = isect.wo;
+				const Vec3f normal = Normalize(Vec3f(isect.shading.n));
+
+				// direct, nothing to do on perfectly specular surfaces
+				if(isect.bsdf->getNumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0){
+					const Light* light = nullptr;
+					float pmf = 0.f;
+					if(lightDistribution)
+						light = lightDistribution->sample(isect, u[0], &pmf);
+					else if(!scene.lights.empty()){
+						const int n = scene.lights.size();
+						light = scene.lights[std::min((int)(u[0] * n), n - 1)].get();
+						pmf = 1.f / n;
+					}
+					Vec3f wi;
+					float pdf_light = 0.f;
+					VisibilityTester vis;
+					const Spectrum L_light = light ?
+						light->sample_Li(isect, Point2f(u[1], u[2]), &wi, &pdf_light, &vis) : Spectrum(0.f);
+					if(!L_light.isBlack() && pdf_light > 0.f){
+						const Spectrum f = isect.bsdf->f(wo, wi) * AbsDot(wi, normal);
+						if(!f.isBlack()){
+							pdf_light *= pmf;
+							const bool isDelta = (int)light->flags &
+								((int)LightFlags::DeltaPosition | (int)LightFlags::DeltaDirection);
+							const float weight = isDelta ? 1.f :
+								PowerHeuristic(1, pdf_light, 1, isect.bsdf->pdf(wo, wi));
+							shadowQueue.push(ShadowItem{vis, path.throughput * f * L_light * weight / pdf_light,
+								item.pathIndex});
+						}
+					}
+				}
+
+				// indirect
+				Vec3f wi;
+				float pdf_bsdf = 0.f;
+				BxDFType sampledType;
+				const Spectrum f = isect.bsdf->sample_f(wo, &wi, Point2f(u[3], u[4]), &pdf_bsdf,
+					BSDF_ALL, &sampledType);
+				if(f.isBlack() || pdf_bsdf == 0.f)
+					return;
+				path.throughput *= f * AbsDot(wi, normal) / pdf_bsdf;
+				path.pdf_bsdf = pdf_bsdf;
+				path.specularBounce = (sampledType & BSDF_SPECULAR) != 0;
+				if((sampledType & BSDF_SPECULAR) && (sampledType & BSDF_TRANSMISSION)){
+					const float eta = isect.bsdf->eta;
+					path.etaScale *= Dot(wo, Vec3f(isect.n)) > 0.f ? eta * eta : 1.f / (eta * eta);
+				}
+				path.prevP = isect.p;
+				path.prevN = isect.n;
+
+				// russian roulette as in PathIntegrator
+				const Spectrum rrThroughput = path.throughput * path.etaScale;
+				if(depth >= PathIntegrator::MinRRDepth && rrThroughput.maxComponentValue() < rrThreshold){
+					const float q = std::max(0.05f, 1.f - rrThroughput.maxComponentValue());
+					if(u[5] < q)
+						return;
+					path.throughput /= 1.f - q;
+				}
+				nextRayQueue.push(RayItem{isect.spawnRay(wi), item.pathIndex});
+			});
+		}
+		// the bsdfs are not needed past shading
+		for(MemoryArena& arena : arenas)
+			arena.reset();
+		shadeQueue.count = 0;
+
+		// shadow rays, a path has at most one in the queue
+		tbb::parallel_for(0, shadowQueue.size(), [&](int i){
+			const ShadowItem& shadow = shadowQueue.items[i];
+			if(shadow.vis.unoccluded(scene))
+				paths[shadow.pathIndex].L += shadow.Ld;
+		});
+		shadowQueue.count = 0;
+
+		std::swap(rayQueue.items, nextRayQueue.items);
+		rayQueue.count = nextRayQueue.size();
+		nextRayQueue.count = 0;
+	}
+
+	// accumulation, the samples of a tile in the order they were taken
+	tbb::parallel_for(0, nTiles, [&](int tile){
+		const Bounds2i bounds = tileBounds(tile);
+		std::unique_ptr<FilmTile> filmTile = film->getFilmTile(bounds);
+		for(int y=bounds.pMin.y; y<bounds.pMax.y; ++y)
+			for(int x=bounds.pMin.x; x<bounds.pMax.x; ++x){
+				const int pathBase = tile * pathsPerTile +
+					((y - bounds.pMin.y) * TileSize + x - bounds.pMin.x) * nSamples;
+				for(int s=0; s<nSamples; ++s){
+					const PathState& path = paths[pathBase + s];
+					filmTile->addSample(path.cameraSample.samplePoints, path.L, path.rayWeight);
+				}
+			}
+		film->mergeFilmTile(*filmTile);
+	});
+}
+
+RIGA_NAMESPACE_END
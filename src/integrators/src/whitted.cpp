@@ -4,7 +4,8 @@
 
 RIGA_NAMESPACE_BEGIN
 
-Spectrum WhittedIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& sampler, int depth) const{
+Spectrum WhittedIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& sampler, 
+	MemoryArena& arena, int depth) const{
 	Spectrum L(0.);
 	SurfaceInteraction inter;
 
@@ -15,27 +16,38 @@ Spectrum WhittedIntegrator::Li(const Ray& ray, const Scene& scene, Sampler& samp
 
 	Vec3f normal = Normalize(Vec3f(inter.shading.n));
 	Vec3f wo = inter.wo;
-	inter.computeScatteringFunctions(ray);
+	inter.computeScatteringFunctions(ray, arena);
 
 	L += inter.Le(wo);
-	for(const auto &light : scene.lights){
+	auto directLight = [&](const Light& light) -> Spectrum{
 		Vec3f wi;
 		float pdf = 0.f;
 		VisibilityTester vis;
-		Spectrum L_light = light->sample_Li(inter, sampler.get2D(), &wi, &pdf, &vis);
+		Spectrum L_light = light.sample_Li(inter, sampler.get2D(), &wi, &pdf, &vis);
 		if(L_light.isBlack() || pdf == 0.f)
-			continue;
+			return Spectrum(0.f);
 		Spectrum f = inter.bsdf->f(wo, wi);
 		if(!f.isBlack() && vis.unoccluded(scene))
-			L += f * L_light * AbsDot(wi, normal) / pdf;
+			return f * L_light * AbsDot(wi, normal) / pdf;
+		return Spectrum(0.f);
+	};
+	if(lightDistribution){
+		// a single light, weighted by the probability of picking it
+		float lightPmf = 0.f;
+		const Light* light = lightDistribution->sample(inter, sampler.get1D(), &lightPmf);
+		if(light)
+			L += directLight(*light) / lightPmf;
+	}else{
+		for(const auto &light : scene.lights)
+			L += directLight(*light);
 	}
 
 	if(depth + 1 < maxDepth){
-		Spectrum L_tmp = specularReflect(ray, inter, scene, sampler, depth);
+		Spectrum L_tmp = specularReflect(ray, inter, scene, sampler, arena, depth);
 		// if(L_tmp != Spectrum(0.f))
 		// 	std::cout << L_tmp << std::endl;
 		L += L_tmp;
-		L += specularTransmit(ray, inter, scene, sampler, depth);
+		L += specularTransmit(ray, inter, scene, sampler, arena, depth);
 	}
 	return L;
 }
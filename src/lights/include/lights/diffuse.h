@@ -16,6 +16,8 @@ public:
 	Spectrum sample_Li(const Interaction& ref, const Point2f& sample, 
 							  Vec3f* wi, float *pdf, VisibilityTester* vis) const;
 	float pdf_Li(const Interaction& ref, const Vec3f& wi) const;
+	Spectrum power() const;
+	LightBounds bounds() const;
 
 
 private:
@@ -28,4 +28,15 @@ float DiffuseAreaLight::pdf_Li(const Interaction& ref, const Vec3f& wi) const{
 	return shape->pdf(ref, wi);
 }
 
+Spectrum DiffuseAreaLight::power() const{
+	return (twoSided ? 2.f : 1.f) * PI * shape->area() * Lemit;
+}
+
+LightBounds DiffuseAreaLight::bounds() const{
+	// cosine falloff over the hemisphere of every normal
+	const DirectionCone normals = shape->normalBounds();
+	return LightBounds(shape->worldBound(), normals.w, power().maxComponentValue(), 
+		normals.cosTheta, 0.f, twoSided);
+}
+
 RIGA_NAMESPACE_END
\ No newline at end of file
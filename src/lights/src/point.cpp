@@ -14,4 +14,14 @@ float PointLight::pdf_Li(const Interaction& ref, const Vec3f& wi) const{
 	return 0;
 }
 
+Spectrum PointLight::power() const{
+	return 4.f * PI * intensity;
+}
+
+LightBounds PointLight::bounds() const{
+	// every direction, no falloff
+	return LightBounds(Bounds3f(pLight), Vec3f(0.f, 0.f, 1.f), power().maxComponentValue(), 
+		-1.f, 0.f, false);
+}
+
 RIGA_NAMESPACE_END
\ No newline at end of file
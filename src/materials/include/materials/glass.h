@@ -12,7 +12,8 @@ public:
                 const std::shared_ptr<Texture<float>> &eta)
                 : kr(kr), kt(kt), index(eta){}
 	void computeScatteringFunctions(
-		SurfaceInteraction* isect, TransportMode mode) const;
+		SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const;
+	Spectrum albedo(const SurfaceInteraction& isect) const;
 
 private:
     std::shared_ptr<Texture<Spectrum>> kr;
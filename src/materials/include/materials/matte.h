@@ -10,7 +10,8 @@ public:
 	MatteMaterial(const std::shared_ptr<Texture<Spectrum>>& kd,
 		const std::shared_ptr<Texture<float>>& sigma = nullptr) : kd(kd), sigma(sigma){}
 	void computeScatteringFunctions(
-		SurfaceInteraction* isect, TransportMode mode) const;
+		SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const;
+	Spectrum albedo(const SurfaceInteraction& isect) const;
 
 private:
 	std::shared_ptr<Texture<Spectrum>> kd;
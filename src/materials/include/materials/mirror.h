@@ -9,7 +9,8 @@ class MirrorMaterial : public Material{
 public:
 	MirrorMaterial(const std::shared_ptr<Texture<Spectrum>> &r) : kr(r){}
 	void computeScatteringFunctions(
-		SurfaceInteraction* isect, TransportMode mode) const;
+		SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const;
+	Spectrum albedo(const SurfaceInteraction& isect) const;
 
 private:
 	std::shared_ptr<Texture<Spectrum>> kr;
@@ -2,22 +2,27 @@
 #include <core/interaction.h>
 #include <core/texture.h>
 #include <core/reflection.h>
+#include <core/memory.h>
 
 RIGA_NAMESPACE_BEGIN
 
 void GlassMaterial::computeScatteringFunctions(
-    SurfaceInteraction* isect, TransportMode mode) const{
-    isect->bsdf = std::make_unique<BSDF>(*isect);
+    SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const{
+    float eta = Clamp(index->evaluate(*isect), 0, Infinity);
+    isect->bsdf = ARENA_ALLOC(arena, BSDF)(*isect, eta);
     Spectrum R = Clamp(kr->evaluate(*isect), 0, Infinity);
     Spectrum T = Clamp(kr->evaluate(*isect), 0, Infinity);
-    float eta = Clamp(index->evaluate(*isect), 0, Infinity);
 
 	if(!R.isBlack()){
-		isect->bsdf->add(new SpecularReflection(R, std::make_unique<FresnelDielectric>(1.f, eta)));
+		isect->bsdf->add(ARENA_ALLOC(arena, SpecularReflection)(R, ARENA_ALLOC(arena, FresnelDielectric)(1.f, eta)));
 	}
     if(!T.isBlack()){
-		isect->bsdf->add(new SpecularTransmission(T, 1.f, eta, mode));
+		isect->bsdf->add(ARENA_ALLOC(arena, SpecularTransmission)(T, 1.f, eta, mode));
 	}
 }
 
+Spectrum GlassMaterial::albedo(const SurfaceInteraction& isect) const{
+    return Clamp(kt->evaluate(isect), 0, 1);
+}
+
 RIGA_NAMESPACE_END
\ No newline at end of file
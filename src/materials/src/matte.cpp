@@ -3,16 +3,21 @@
 #include <core/reflection.h>
 #include <core/interaction.h>
 #include <core/texture.h>
+#include <core/memory.h>
 
 RIGA_NAMESPACE_BEGIN
 
 void MatteMaterial::computeScatteringFunctions(
-	SurfaceInteraction* isect, TransportMode mode) const{
-	isect->bsdf = std::make_unique<BSDF>(*isect);
+	SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const{
+	isect->bsdf = ARENA_ALLOC(arena, BSDF)(*isect);
 	Spectrum r = Clamp(kd->evaluate(*isect), 0, Infinity);
 	if(!r.isBlack()){
-		isect->bsdf->add(new LambertianReflection(r));
+		isect->bsdf->add(ARENA_ALLOC(arena, LambertianReflection)(r));
 	}
 }
 
+Spectrum MatteMaterial::albedo(const SurfaceInteraction& isect) const{
+	return Clamp(kd->evaluate(isect), 0, 1);
+}
+
 RIGA_NAMESPACE_END
\ No newline at end of file
@@ -3,16 +3,21 @@
 #include <core/reflection.h>
 #include <core/interaction.h>
 #include <core/texture.h>
+#include <core/memory.h>
 
 RIGA_NAMESPACE_BEGIN
 
 void MirrorMaterial::computeScatteringFunctions(
-	SurfaceInteraction* isect, TransportMode mode) const{
-	isect->bsdf = std::make_unique<BSDF>(*isect);
+	SurfaceInteraction* isect, MemoryArena& arena, TransportMode mode) const{
+	isect->bsdf = ARENA_ALLOC(arena, BSDF)(*isect);
 	Spectrum r = Clamp(kr->evaluate(*isect), 0, Infinity);
 	if(!r.isBlack()){
-		isect->bsdf->add(new SpecularReflection(r, std::make_unique<FresnelNoOp>()));
+		isect->bsdf->add(ARENA_ALLOC(arena, SpecularReflection)(r, ARENA_ALLOC(arena, FresnelNoOp)()));
 	}
 }
 
+Spectrum MirrorMaterial::albedo(const SurfaceInteraction& isect) const{
+	return Clamp(kr->evaluate(isect), 0, 1);
+}
+
 RIGA_NAMESPACE_END
\ No newline at end of file
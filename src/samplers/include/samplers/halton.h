@@ -16,6 +16,9 @@ class HaltonSampler : public GlobalSampler{
   private:
     // HaltonSampler Private Data
     static std::vector<uint16_t> radicalInversePermutations;
+    // scrambled tables for dimensions 2 and 3, the first bounce after the camera
+    static std::unique_ptr<RadicalInverseTable<5>> scrambledRadicalInverse5;
+    static std::unique_ptr<RadicalInverseTable<7>> scrambledRadicalInverse7;
     Point2i baseScales, baseExponents;
     int sampleStride;
     int multInverse[2];
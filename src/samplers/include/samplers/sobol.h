@@ -0,0 +1,27 @@
+#pragma once
+#include <core/common.h>
+#include <core/sampler.h>
+#include <core/lowdiscrepancy.h>
+
+RIGA_NAMESPACE_BEGIN
+// Sobol sampler, every pixel runs its own randomized copy of the sequence, so the
+// dimensions of a sample cost a generator matrix product and a scramble each
+class SobolSampler : public GlobalSampler {
+  public:
+    // SobolSampler Public Methods
+    SobolSampler(int64_t samplesPerPixel,
+                 RandomizeStrategy randomize = RandomizeStrategy::Owen,
+                 uint32_t seed = 0);
+    int64_t getIndexForSample(int64_t sampleNum) const;
+    float sampleDimension(int64_t index, int dimension) const;
+    std::unique_ptr<Sampler> clone(int seed);
+
+  private:
+    // SobolSampler Private Data
+    RandomizeStrategy randomize;
+    uint32_t seed;
+};
+
+SobolSampler *CreateSobolSampler(int pixelSamples,
+                                 RandomizeStrategy randomize = RandomizeStrategy::Owen);
+RIGA_NAMESPACE_END
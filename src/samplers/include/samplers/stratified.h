@@ -0,0 +1,23 @@
+#pragma once
+#include <core/common.h>
+#include <core/sampler.h>
+
+RIGA_NAMESPACE_BEGIN
+// per pixel tables of jittered stratified samples, shuffled across dimensions
+class StratifiedSampler : public PixelSampler {
+  public:
+    // StratifiedSampler Public Methods
+    StratifiedSampler(int xPixelSamples, int yPixelSamples, bool jitterSamples = true,
+                      int nSampledDimensions = 4);
+    void startPixel(const Point2i &);
+    std::unique_ptr<Sampler> clone(int seed);
+
+  private:
+    // StratifiedSampler Private Data
+    const int xPixelSamples, yPixelSamples;
+    const bool jitterSamples;
+};
+
+StratifiedSampler *CreateStratifiedSampler(int xPixelSamples, int yPixelSamples,
+                                           bool jitter = true, int nSampledDimensions = 4);
+RIGA_NAMESPACE_END
@@ -0,0 +1,20 @@
+#pragma once
+#include <core/common.h>
+#include <core/sampler.h>
+#include <core/lowdiscrepancy.h>
+
+RIGA_NAMESPACE_BEGIN
+// per pixel tables of scrambled (0,2)-sequence samples, van der Corput in 1D and
+// the first two Sobol dimensions in 2D. the sample count is rounded up to a power of 2
+class ZeroTwoSequenceSampler : public PixelSampler {
+  public:
+    // ZeroTwoSequenceSampler Public Methods
+    ZeroTwoSequenceSampler(int64_t samplesPerPixel, int nSampledDimensions = 4);
+    void startPixel(const Point2i &);
+    std::unique_ptr<Sampler> clone(int seed);
+    int roundCount(int count) const { return RoundUpPow2(count); }
+};
+
+ZeroTwoSequenceSampler *CreateZeroTwoSequenceSampler(int pixelSamples,
+                                                     int nSampledDimensions = 4);
+RIGA_NAMESPACE_END
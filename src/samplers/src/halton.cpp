@@ -33,6 +33,10 @@ HaltonSampler::HaltonSampler(int samplesPerPixel, const Bounds2i &sampleBounds,
     if (radicalInversePermutations.empty()) {
         pcg32 rng;
         radicalInversePermutations = ComputeRadicalInversePermutations(rng);
+        scrambledRadicalInverse5.reset(
+            new RadicalInverseTable<5>(permutationForDimension(2)));
+        scrambledRadicalInverse7.reset(
+            new RadicalInverseTable<7>(permutationForDimension(3)));
     }
 
     // Find radical inverse base scales and exponents that cover sampling area
@@ -57,6 +61,8 @@ HaltonSampler::HaltonSampler(int samplesPerPixel, const Bounds2i &sampleBounds,
 }
 
 std::vector<uint16_t> HaltonSampler::radicalInversePermutations;
+std::unique_ptr<RadicalInverseTable<5>> HaltonSampler::scrambledRadicalInverse5;
+std::unique_ptr<RadicalInverseTable<7>> HaltonSampler::scrambledRadicalInverse7;
 int64_t HaltonSampler::getIndexForSample(int64_t sampleNum) const {
     if (currentPixel != pixelForOffset) {
         // Compute Halton sample offset for _currentPixel_
@@ -85,6 +91,12 @@ float HaltonSampler::sampleDimension(int64_t index, int dim) const {
         return RadicalInverse(dim, index >> baseExponents[0]);
     else if (dim == 1)
         return RadicalInverse(dim, index / baseScales[1]);
+    // with blue noise the pixels share the sequence past the camera dimensions
+    if (blueNoise) index = (index - offsetForCurrentPixel) / sampleStride;
+    if (dim == 2)
+        return (*scrambledRadicalInverse5)(index);
+    else if (dim == 3)
+        return (*scrambledRadicalInverse7)(index);
     else
         return ScrambledRadicalInverse(dim, index,
                                        permutationForDimension(dim));
@@ -0,0 +1,36 @@
+#include <samplers/sobol.h>
+
+RIGA_NAMESPACE_BEGIN
+// SobolSampler Method Definitions
+SobolSampler::SobolSampler(int64_t samplesPerPixel, RandomizeStrategy randomize,
+                           uint32_t seed)
+    : GlobalSampler(samplesPerPixel), randomize(randomize), seed(seed) {
+    // build the generator matrices now rather than in the first render thread
+    SobolMatrices32();
+}
+
+int64_t SobolSampler::getIndexForSample(int64_t sampleNum) const {
+    return sampleNum;
+}
+
+float SobolSampler::sampleDimension(int64_t index, int dim) const {
+    if (dim >= NumSobolDimensions)
+        throw("SobolSampler can only sample 1024 dimensions.");
+    // the randomization of every pixel and dimension is independent, blue noise shares
+    // one randomization among the pixels
+    const uint64_t pixelBits =
+        blueNoise ? 0 : ((uint64_t)(uint32_t)currentPixel.x << 32) ^ (uint32_t)currentPixel.y;
+    const uint64_t pixelHash = MixBits(pixelBits ^ ((uint64_t)seed << 16));
+    const uint32_t dimSeed = (uint32_t)MixBits(pixelHash ^ (uint64_t)dim);
+    return SobolSample((uint32_t)index, dim, randomize, dimSeed);
+}
+
+std::unique_ptr<Sampler> SobolSampler::clone(int seed) {
+    return std::unique_ptr<Sampler>(new SobolSampler(*this));
+}
+
+SobolSampler *CreateSobolSampler(int pixelSamples, RandomizeStrategy randomize) {
+    return new SobolSampler(pixelSamples, randomize);
+}
+
+RIGA_NAMESPACE_END
@@ -0,0 +1,40 @@
+#include <samplers/zerotwosequence.h>
+
+RIGA_NAMESPACE_BEGIN
+// ZeroTwoSequenceSampler Method Definitions
+ZeroTwoSequenceSampler::ZeroTwoSequenceSampler(int64_t samplesPerPixel,
+                                               int nSampledDimensions)
+    : PixelSampler(RoundUpPow2(samplesPerPixel), nSampledDimensions) {
+    if (!IsPowerOf2(samplesPerPixel))
+        std::cout << "Pixel samples being rounded up to power of 2 (from "
+                  << samplesPerPixel << " to " << this->samplesPerPixel << ")"
+                  << std::endl;
+}
+
+void ZeroTwoSequenceSampler::startPixel(const Point2i &p) {
+    PixelSampler::startPixel(p);
+    // Generate 1D and 2D pixel sample components using $(0,2)$-sequence
+    for (size_t i = 0; i < samples1D.size(); ++i)
+        VanDerCorput(1, samplesPerPixel, &samples1D[i][0], rng);
+    for (size_t i = 0; i < samples2D.size(); ++i)
+        Sobol2D(1, samplesPerPixel, &samples2D[i][0], rng);
+
+    // Generate 1D and 2D array samples using $(0,2)$-sequence
+    for (size_t i = 0; i < samples1DArraySizes.size(); ++i)
+        VanDerCorput(samples1DArraySizes[i], samplesPerPixel,
+                     &sampleArray1D[i][0], rng);
+    for (size_t i = 0; i < samples2DArraySizes.size(); ++i)
+        Sobol2D(samples2DArraySizes[i], samplesPerPixel, &sampleArray2D[i][0],
+                rng);
+}
+
+std::unique_ptr<Sampler> ZeroTwoSequenceSampler::clone(int seed) {
+    return std::unique_ptr<Sampler>(new ZeroTwoSequenceSampler(*this));
+}
+
+ZeroTwoSequenceSampler *CreateZeroTwoSequenceSampler(int pixelSamples,
+                                                     int nSampledDimensions) {
+    return new ZeroTwoSequenceSampler(pixelSamples, nSampledDimensions);
+}
+
+RIGA_NAMESPACE_END
@@ -86,7 +86,14 @@ public:
 	bool intersect(const Ray& ray, float *tHit, SurfaceInteraction* isect) const;
 	bool intersectP(const Ray& ray) const;
 	float area() const;
+	DirectionCone normalBounds() const;
 	Interaction sample(const Point2f& u, float *pdf) const;
+	// world space vertices, for aggregates that keep their own copy of the triangle
+	void getVertices(Point3f p[3]) const{
+		p[0] = mesh->p[vIndex[0]];
+		p[1] = mesh->p[vIndex[1]];
+		p[2] = mesh->p[vIndex[2]];
+	}
 
 private:
 	std::shared_ptr<TriangleMesh> mesh;
@@ -240,6 +240,21 @@ float Triangle::area() const{
 	return 0.5f * Cross(v1 - v0, v2 - v0).length();
 }
 
+DirectionCone Triangle::normalBounds() const{
+	const Point3f& v0 = mesh->p[vIndex[0]];
+	const Point3f& v1 = mesh->p[vIndex[1]];
+	const Point3f& v2 = mesh->p[vIndex[2]];
+	Normal3f n = Normalize(Normal3f(Cross(v1 - v0, v2 - v0)));
+	// oriented like the normals of sample, by the shading normals or the orientation
+	if(mesh->n){
+		Normal3f ns(mesh->n[vIndex[0]] + mesh->n[vIndex[1]] + mesh->n[vIndex[2]]);
+		n.faceForward(ns);
+	}else if(reverseOrientation){
+		n *= -1;
+	}
+	return DirectionCone(Vec3f(n), 1.f);
+}
+
 Interaction Triangle::sample(const Point2f& u, float *pdf) const{
 	Point2f b = UniformSampleTriangle(u);
 